@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "acmatch.h"
+
+static inline unsigned char lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+}
+
+int32_t acmatch_state(acmatch_t *ac) {
+    if(ac->nstates == ac->size) {
+        ac->size *= 2;
+        ac->delta = realloc(ac->delta, ac->size * 256 * sizeof(int32_t));
+        ac->out = realloc(ac->out, ac->size * sizeof(uint64_t));
+    }
+    memset(ac->delta + ac->nstates * 256, 0xff, 256 * sizeof(int32_t));
+    ac->out[ac->nstates] = 0;
+    return ac->nstates++;
+}
+
+acmatch_t *acmatch_new(void) {
+    acmatch_t *ac = calloc(1, sizeof(acmatch_t));
+    ac->size = 16;
+    ac->delta = malloc(ac->size * 256 * sizeof(int32_t));
+    ac->out = malloc(ac->size * sizeof(uint64_t));
+    acmatch_state(ac);
+    return ac;
+}
+
+void acmatch_free(acmatch_t *ac) {
+    if(ac == NULL) {
+        return;
+    }
+    free(ac->delta);
+    free(ac->out);
+    free(ac);
+}
+
+/* needles are added to the trie lowercased; compiling gives uppercase
+ * letters the same transitions */
+void acmatch_add(acmatch_t *ac, const char *needle, size_t len, unsigned bit) {
+    int32_t state = 0;
+    size_t i;
+
+    for(i = 0; i < len; i++) {
+        unsigned char c = lower(needle[i]);
+        int32_t next = ac->delta[state * 256 + c];
+        if(next < 0) {
+            next = acmatch_state(ac);
+            ac->delta[state * 256 + c] = next;
+        }
+        state = next;
+    }
+    ac->out[state] |= (uint64_t) 1 << bit;
+}
+
+/* turns the trie into a full transition table, breadth first so that a
+ * state's failure link is complete before its children are visited */
+void acmatch_compile(acmatch_t *ac) {
+    int32_t *queue = malloc(ac->nstates * sizeof(int32_t));
+    int32_t *fail = calloc(ac->nstates, sizeof(int32_t));
+    size_t head = 0, tail = 0;
+    int c;
+
+    for(c = 0; c < 256; c++) {
+        int32_t next = ac->delta[lower(c)];
+        if(next < 0) {
+            ac->delta[c] = 0;
+        } else if(c == lower(c)) {
+            fail[next] = 0;
+            queue[tail++] = next;
+        }
+    }
+    for(c = 'A'; c <= 'Z'; c++) {
+        ac->delta[c] = ac->delta[lower(c)];
+    }
+
+    while(head < tail) {
+        int32_t state = queue[head++];
+        int32_t *row = ac->delta + state * 256;
+        const int32_t *frow = ac->delta + fail[state] * 256;
+
+        ac->out[state] |= ac->out[fail[state]];
+
+        for(c = 0; c < 256; c++) {
+            if(c != lower(c)) {
+                continue;
+            }
+            if(row[c] < 0) {
+                row[c] = frow[c];
+            } else {
+                fail[row[c]] = frow[c];
+                queue[tail++] = row[c];
+            }
+        }
+        for(c = 'A'; c <= 'Z'; c++) {
+            row[c] = row[lower(c)];
+        }
+    }
+
+    free(queue);
+    free(fail);
+}
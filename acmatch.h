@@ -0,0 +1,36 @@
+#ifndef PACFIND_ACMATCH_H
+#define PACFIND_ACMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ACMATCH_MAX 64
+
+/* Aho-Corasick automaton over up to 64 case-insensitive literals; scanning
+ * a string once reports every literal it contains as a bit in a mask */
+typedef struct acmatch_t {
+    size_t nstates;
+    size_t size;
+    int32_t *delta;
+    uint64_t *out;
+} acmatch_t;
+
+acmatch_t *acmatch_new(void);
+void acmatch_add(acmatch_t *ac, const char *needle, size_t len, unsigned bit);
+void acmatch_compile(acmatch_t *ac);
+void acmatch_free(acmatch_t *ac);
+
+static inline uint64_t acmatch_scan(const acmatch_t *ac, const char *str, size_t len) {
+    const unsigned char *s = (const unsigned char*) str;
+    uint64_t hits = 0;
+    int32_t state = 0;
+    size_t i;
+
+    for(i = 0; i < len; i++) {
+        state = ac->delta[state * 256 + s[i]];
+        hits |= ac->out[state];
+    }
+    return hits;
+}
+
+#endif /* PACFIND_ACMATCH_H */
@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+
+/* The set operations below are plain loops over whole words; they are kept
+ * free of aliasing and branches so the compiler can vectorize them. */
+
+bitset_t *bitset_new(size_t nbits) {
+    bitset_t *b = malloc(sizeof(bitset_t));
+    b->nbits = nbits;
+    b->nwords = (nbits + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+    b->words = calloc(b->nwords ? b->nwords : 1, sizeof(uint64_t));
+    return b;
+}
+
+bitset_t *bitset_new_full(size_t nbits) {
+    bitset_t *b = bitset_new(nbits);
+    size_t tail = nbits % BITSET_WORD_BITS;
+    memset(b->words, 0xff, b->nwords * sizeof(uint64_t));
+    if(tail) {
+        b->words[b->nwords - 1] = ((uint64_t) 1 << tail) - 1;
+    }
+    return b;
+}
+
+bitset_t *bitset_copy(const bitset_t *b) {
+    bitset_t *c = bitset_new(b->nbits);
+    memcpy(c->words, b->words, b->nwords * sizeof(uint64_t));
+    return c;
+}
+
+void bitset_free(bitset_t *b) {
+    if(b == NULL) {
+        return;
+    }
+    free(b->words);
+    free(b);
+}
+
+void bitset_clear_all(bitset_t *b) {
+    memset(b->words, 0, b->nwords * sizeof(uint64_t));
+}
+
+void bitset_and(bitset_t *dst, const bitset_t *src) {
+    uint64_t *restrict d = dst->words;
+    const uint64_t *restrict s = src->words;
+    size_t i, n = dst->nwords;
+    for(i = 0; i < n; i++) {
+        d[i] &= s[i];
+    }
+}
+
+void bitset_or(bitset_t *dst, const bitset_t *src) {
+    uint64_t *restrict d = dst->words;
+    const uint64_t *restrict s = src->words;
+    size_t i, n = dst->nwords;
+    for(i = 0; i < n; i++) {
+        d[i] |= s[i];
+    }
+}
+
+void bitset_xor(bitset_t *dst, const bitset_t *src) {
+    uint64_t *restrict d = dst->words;
+    const uint64_t *restrict s = src->words;
+    size_t i, n = dst->nwords;
+    for(i = 0; i < n; i++) {
+        d[i] ^= s[i];
+    }
+}
+
+void bitset_andnot(bitset_t *dst, const bitset_t *src) {
+    uint64_t *restrict d = dst->words;
+    const uint64_t *restrict s = src->words;
+    size_t i, n = dst->nwords;
+    for(i = 0; i < n; i++) {
+        d[i] &= ~s[i];
+    }
+}
+
+size_t bitset_count(const bitset_t *b) {
+    size_t i, count = 0;
+    for(i = 0; i < b->nwords; i++) {
+        count += __builtin_popcountll(b->words[i]);
+    }
+    return count;
+}
+
+int bitset_empty(const bitset_t *b) {
+    size_t i;
+    for(i = 0; i < b->nwords; i++) {
+        if(b->words[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* returns the index of the first set bit at or after from, or nbits */
+size_t bitset_next(const bitset_t *b, size_t from) {
+    size_t w = from / BITSET_WORD_BITS;
+    uint64_t word;
+
+    if(from >= b->nbits) {
+        return b->nbits;
+    }
+
+    word = b->words[w] & (~(uint64_t) 0 << (from % BITSET_WORD_BITS));
+    while(!word) {
+        if(++w >= b->nwords) {
+            return b->nbits;
+        }
+        word = b->words[w];
+    }
+
+    return w * BITSET_WORD_BITS + __builtin_ctzll(word);
+}
@@ -0,0 +1,46 @@
+#ifndef PACFIND_BITSET_H
+#define PACFIND_BITSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BITSET_WORD_BITS 64
+
+typedef struct bitset_t {
+    size_t nbits;
+    size_t nwords;
+    uint64_t *words;
+} bitset_t;
+
+bitset_t *bitset_new(size_t nbits);
+bitset_t *bitset_new_full(size_t nbits);
+bitset_t *bitset_copy(const bitset_t *b);
+void bitset_free(bitset_t *b);
+
+void bitset_clear_all(bitset_t *b);
+
+void bitset_and(bitset_t *dst, const bitset_t *src);
+void bitset_or(bitset_t *dst, const bitset_t *src);
+void bitset_xor(bitset_t *dst, const bitset_t *src);
+void bitset_andnot(bitset_t *dst, const bitset_t *src);
+
+size_t bitset_count(const bitset_t *b);
+int bitset_empty(const bitset_t *b);
+size_t bitset_next(const bitset_t *b, size_t from);
+
+static inline void bitset_set(bitset_t *b, size_t i) {
+    b->words[i / BITSET_WORD_BITS] |= (uint64_t) 1 << (i % BITSET_WORD_BITS);
+}
+
+static inline void bitset_unset(bitset_t *b, size_t i) {
+    b->words[i / BITSET_WORD_BITS] &= ~((uint64_t) 1 << (i % BITSET_WORD_BITS));
+}
+
+static inline int bitset_test(const bitset_t *b, size_t i) {
+    return (b->words[i / BITSET_WORD_BITS] >> (i % BITSET_WORD_BITS)) & 1;
+}
+
+/* iterate over every set bit: for(i = bitset_first(b); i < b->nbits; i = bitset_next(b, i + 1)) */
+#define bitset_first(b) bitset_next((b), 0)
+
+#endif /* PACFIND_BITSET_H */
@@ -0,0 +1,377 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+#define CACHE_MAGIC "pacfind"
+#define CACHE_VERSION 3
+#define CACHE_ALIGN(n) (((n) + 7) & ~(size_t) 7)
+
+typedef struct cachehdr_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t local;
+    uint32_t ncols[3];
+    uint32_t itemsize;
+    cachekey_t key;
+    uint64_t count;
+    uint64_t arena_len;
+    uint64_t list_len[LCOL_COUNT];
+    uint64_t tri_nkeys;
+    uint64_t tri_nids;
+    uint64_t size;
+} cachehdr_t;
+
+/* a column as stored in the cache file, in file order */
+typedef struct section_t {
+    void **ptr;
+    size_t size;
+} section_t;
+
+#define CACHE_SECTIONS (NCOL_COUNT + 2 * SCOL_COUNT + 2 * LCOL_COUNT + 4)
+
+size_t cache_sections(dbsnap_t *db, section_t *sec) {
+    size_t n = 0;
+    int c;
+
+    for(c = 0; c < NCOL_COUNT; c++) {
+        sec[n].ptr = (void**) &db->num[c];
+        sec[n++].size = db->count * sizeof(int64_t);
+    }
+    for(c = 0; c < SCOL_COUNT; c++) {
+        sec[n].ptr = (void**) &db->str_off[c];
+        sec[n++].size = db->count * sizeof(uint32_t);
+        sec[n].ptr = (void**) &db->str_len[c];
+        sec[n++].size = db->count * sizeof(uint32_t);
+    }
+    for(c = 0; c < LCOL_COUNT; c++) {
+        sec[n].ptr = (void**) &db->list_start[c];
+        sec[n++].size = (db->count + 1) * sizeof(uint32_t);
+        sec[n].ptr = (void**) &db->list_items[c];
+        sec[n++].size = db->list_len[c] * sizeof(snapitem_t);
+    }
+    sec[n].ptr = (void**) &db->tri_keys;
+    sec[n++].size = db->tri_nkeys * sizeof(uint32_t);
+    sec[n].ptr = (void**) &db->tri_start;
+    sec[n++].size = (db->tri_nkeys + 1) * sizeof(uint32_t);
+    sec[n].ptr = (void**) &db->tri_ids;
+    sec[n++].size = db->tri_nids * sizeof(uint32_t);
+    sec[n].ptr = (void**) &db->arena;
+    sec[n++].size = db->arena_len;
+
+    return n;
+}
+
+void cache_key_stat(const struct stat *st, cachekey_t *key) {
+    key->dev = st->st_dev;
+    key->ino = st->st_ino;
+    key->size = st->st_size;
+    key->mtime_sec = st->st_mtim.tv_sec;
+    key->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+uint64_t cache_mix(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    while(len--) {
+        h ^= *p++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t cache_root(const char *dbpath) {
+    return cache_mix(14695981039346656037ULL, dbpath, strlen(dbpath));
+}
+
+int cache_key_file(const char *dbpath, const char *path, cachekey_t *key) {
+    struct stat st;
+
+    if(stat(path, &st) != 0) {
+        return -1;
+    }
+
+    memset(key, 0, sizeof(cachekey_t));
+    key->root = cache_root(dbpath);
+    cache_key_stat(&st, key);
+    return 0;
+}
+
+int cache_key_sync(const char *dbpath, const char *dbname, cachekey_t *key) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/sync/%s.db", dbpath, dbname);
+    return cache_key_file(dbpath, path, key);
+}
+
+int cache_key_files(const char *dbpath, const char *dbname, cachekey_t *key) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/sync/%s.files", dbpath, dbname);
+    return cache_key_file(dbpath, path, key);
+}
+
+/* installing or removing a package changes the local directory itself, but
+ * pacman rewrites desc files in place (e.g. when changing the install
+ * reason), so every desc file contributes to the key as well */
+int cache_key_local(const char *dbpath, cachekey_t *key) {
+    char path[4096];
+    struct stat st;
+    struct dirent *ent;
+    DIR *dir;
+
+    snprintf(path, sizeof(path), "%s/local", dbpath);
+    if((dir = opendir(path)) == NULL) {
+        return -1;
+    }
+    if(fstat(dirfd(dir), &st) != 0) {
+        closedir(dir);
+        return -1;
+    }
+
+    memset(key, 0, sizeof(cachekey_t));
+    key->root = cache_root(dbpath);
+    cache_key_stat(&st, key);
+
+    while((ent = readdir(dir))) {
+        uint64_t h = 14695981039346656037ULL;
+        struct stat dst;
+
+        if(ent->d_name[0] == '.') {
+            continue;
+        }
+
+        h = cache_mix(h, ent->d_name, strlen(ent->d_name));
+        snprintf(path, sizeof(path), "%s/desc", ent->d_name);
+        if(fstatat(dirfd(dir), path, &dst, 0) == 0) {
+            h = cache_mix(h, &dst.st_mtim.tv_sec, sizeof(dst.st_mtim.tv_sec));
+            h = cache_mix(h, &dst.st_mtim.tv_nsec, sizeof(dst.st_mtim.tv_nsec));
+            h = cache_mix(h, &dst.st_size, sizeof(dst.st_size));
+        }
+        /* readdir order is unspecified, so combine entries commutatively */
+        key->hash += h;
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+int cache_path(const char *name, const cachekey_t *key, char *path, size_t size, int create) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int len;
+
+    if(xdg && *xdg) {
+        len = snprintf(path, size, "%s", xdg);
+    } else if(home && *home) {
+        len = snprintf(path, size, "%s/.cache", home);
+    } else {
+        return -1;
+    }
+    if(create && mkdir(path, 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    len += snprintf(path + len, size - len, "/pacfind");
+    if(create && mkdir(path, 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    if((size_t) snprintf(path + len, size - len, "/%s-%016" PRIx64 ".cache",
+                name, key->root) >= size - len) {
+        return -1;
+    }
+    return 0;
+}
+
+void cache_header(cachehdr_t *hdr, const dbsnap_t *db, const cachekey_t *key) {
+    int c;
+
+    memset(hdr, 0, sizeof(cachehdr_t));
+    memcpy(hdr->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    hdr->version = CACHE_VERSION;
+    hdr->local = db->local;
+    hdr->ncols[0] = SCOL_COUNT;
+    hdr->ncols[1] = LCOL_COUNT;
+    hdr->ncols[2] = NCOL_COUNT;
+    hdr->itemsize = sizeof(snapitem_t);
+    hdr->key = *key;
+    hdr->count = db->count;
+    hdr->arena_len = db->arena_len;
+    for(c = 0; c < LCOL_COUNT; c++) {
+        hdr->list_len[c] = db->list_len[c];
+    }
+    hdr->tri_nkeys = db->tri_nkeys;
+    hdr->tri_nids = db->tri_nids;
+}
+
+void *cache_map(const char *name, const cachekey_t *key, size_t *size) {
+    char path[4096];
+    struct stat st;
+    void *map;
+    int fd;
+
+    if(cache_path(name, key, path, sizeof(path), 0) != 0) {
+        return NULL;
+    }
+    if((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        return NULL;
+    }
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = st.st_size;
+    return map;
+}
+
+/* a cache file is written to a temporary file that is renamed over the old
+ * cache once complete, so concurrent readers only ever see complete files */
+typedef struct cachefile_t {
+    char path[4096];
+    char tmp[4096 + 8];
+    int fd;
+} cachefile_t;
+
+int cache_create(const char *name, const cachekey_t *key, cachefile_t *cf) {
+    if(cache_path(name, key, cf->path, sizeof(cf->path), 1) != 0) {
+        return -1;
+    }
+    snprintf(cf->tmp, sizeof(cf->tmp), "%s.XXXXXX", cf->path);
+    return (cf->fd = mkstemp(cf->tmp)) < 0 ? -1 : 0;
+}
+
+int cache_append(cachefile_t *cf, const void *buf, size_t size) {
+    while(size) {
+        ssize_t n = write(cf->fd, buf, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return -1;
+        }
+        buf = (const char*) buf + n;
+        size -= n;
+    }
+    return 0;
+}
+
+/* renames the file into place if everything was written, otherwise
+ * removes it */
+int cache_commit(cachefile_t *cf, int ok) {
+    if(close(cf->fd) != 0 || !ok || rename(cf->tmp, cf->path) != 0) {
+        unlink(cf->tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int cache_write(const char *name, const cachekey_t *key, const void *buf, size_t size) {
+    cachefile_t cf;
+
+    if(cache_create(name, key, &cf) != 0) {
+        return -1;
+    }
+    return cache_commit(&cf, cache_append(&cf, buf, size) == 0);
+}
+
+dbsnap_t *cache_load(const char *dbname, int local, const cachekey_t *key) {
+    section_t sec[CACHE_SECTIONS];
+    cachehdr_t expect, *hdr;
+    dbsnap_t *db;
+    size_t n, i, off, size;
+    void *map;
+    int c;
+
+    if((map = cache_map(dbname, key, &size)) == NULL) {
+        return NULL;
+    }
+    if(size < sizeof(cachehdr_t)) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    /* everything but the sizes must match what we would write ourselves */
+    hdr = map;
+    db = calloc(1, sizeof(dbsnap_t));
+    db->local = local;
+    db->count = hdr->count;
+    db->arena_len = hdr->arena_len;
+    for(c = 0; c < LCOL_COUNT; c++) {
+        db->list_len[c] = hdr->list_len[c];
+    }
+    db->tri_nkeys = hdr->tri_nkeys;
+    db->tri_nids = hdr->tri_nids;
+    cache_header(&expect, db, key);
+    expect.size = size;
+    if(memcmp(&expect, hdr, sizeof(cachehdr_t)) != 0) {
+        munmap(map, size);
+        free(db);
+        return NULL;
+    }
+
+    n = cache_sections(db, sec);
+    off = CACHE_ALIGN(sizeof(cachehdr_t));
+    for(i = 0; i < n; i++) {
+        if(off + sec[i].size > size) {
+            munmap(map, size);
+            free(db);
+            return NULL;
+        }
+        *sec[i].ptr = (char*) map + off;
+        off = CACHE_ALIGN(off + sec[i].size);
+    }
+
+    db->dbname = strdup(dbname);
+    db->arena_size = db->arena_len;
+    db->map = map;
+    db->map_size = size;
+    return db;
+}
+
+int cache_save(dbsnap_t *db, const cachekey_t *key) {
+    static const char zero[8] = { 0 };
+    section_t sec[CACHE_SECTIONS];
+    cachehdr_t hdr;
+    cachefile_t cf;
+    size_t n, i, off;
+    int ok;
+
+    n = cache_sections(db, sec);
+    off = CACHE_ALIGN(sizeof(cachehdr_t));
+    for(i = 0; i < n; i++) {
+        off = CACHE_ALIGN(off + sec[i].size);
+    }
+    cache_header(&hdr, db, key);
+    hdr.size = off;
+
+    if(cache_create(db->dbname, key, &cf) != 0) {
+        return -1;
+    }
+
+    off = sizeof(cachehdr_t);
+    ok = cache_append(&cf, &hdr, sizeof(cachehdr_t)) == 0
+        && cache_append(&cf, zero, CACHE_ALIGN(off) - off) == 0;
+    off = CACHE_ALIGN(off);
+    for(i = 0; i < n && ok; i++) {
+        ok = cache_append(&cf, *sec[i].ptr, sec[i].size) == 0;
+        off += sec[i].size;
+        if(ok && CACHE_ALIGN(off) != off) {
+            ok = cache_append(&cf, zero, CACHE_ALIGN(off) - off) == 0;
+            off = CACHE_ALIGN(off);
+        }
+    }
+
+    return cache_commit(&cf, ok);
+}
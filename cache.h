@@ -0,0 +1,34 @@
+#ifndef PACFIND_CACHE_H
+#define PACFIND_CACHE_H
+
+#include <stdint.h>
+
+#include "snapshot.h"
+
+/* the state of a database on disk; a cache file is only used if the key it
+ * was written with still matches.  root hashes the database path, which
+ * names the cache file so that several roots keep caches of their own */
+typedef struct cachekey_t {
+    uint64_t root;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t hash;
+} cachekey_t;
+
+int cache_key_sync(const char *dbpath, const char *dbname, cachekey_t *key);
+int cache_key_local(const char *dbpath, cachekey_t *key);
+int cache_key_files(const char *dbpath, const char *dbname, cachekey_t *key);
+
+/* raw access to files in the cache directory, by name without extension
+ * and the key of the database they were made from */
+int cache_path(const char *name, const cachekey_t *key, char *path, size_t size, int create);
+void *cache_map(const char *name, const cachekey_t *key, size_t *size);
+int cache_write(const char *name, const cachekey_t *key, const void *buf, size_t size);
+
+dbsnap_t *cache_load(const char *dbname, int local, const cachekey_t *key);
+int cache_save(dbsnap_t *db, const cachekey_t *key);
+
+#endif /* PACFIND_CACHE_H */
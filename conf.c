@@ -0,0 +1,281 @@
+#include <ctype.h>
+#include <errno.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "conf.h"
+
+#define CONF_MAX_DEPTH 10
+
+#define SIG_PACKAGE_ALL (ALPM_SIG_PACKAGE | ALPM_SIG_PACKAGE_OPTIONAL \
+        | ALPM_SIG_PACKAGE_MARGINAL_OK | ALPM_SIG_PACKAGE_UNKNOWN_OK)
+#define SIG_DATABASE_ALL (ALPM_SIG_DATABASE | ALPM_SIG_DATABASE_OPTIONAL \
+        | ALPM_SIG_DATABASE_MARGINAL_OK | ALPM_SIG_DATABASE_UNKNOWN_OK)
+
+/* the verification and trust halves of both */
+#define SIG_VERIFY (ALPM_SIG_PACKAGE | ALPM_SIG_PACKAGE_OPTIONAL \
+        | ALPM_SIG_DATABASE | ALPM_SIG_DATABASE_OPTIONAL)
+#define SIG_TRUST (ALPM_SIG_PACKAGE_MARGINAL_OK | ALPM_SIG_PACKAGE_UNKNOWN_OK \
+        | ALPM_SIG_DATABASE_MARGINAL_OK | ALPM_SIG_DATABASE_UNKNOWN_OK)
+
+char *conf_trim(char *str) {
+    char *end = str + strlen(str);
+
+    while(isspace((unsigned char) *str)) {
+        str++;
+    }
+    while(end > str && isspace((unsigned char) end[-1])) {
+        end--;
+    }
+    *end = '\0';
+    return str;
+}
+
+confrepo_t *conf_repo(const conf_t *conf, const char *name) {
+    size_t r;
+
+    for(r = 0; r < conf->nrepos; r++) {
+        if(strcmp(conf->repos[r].name, name) == 0) {
+            return conf->repos + r;
+        }
+    }
+    return NULL;
+}
+
+confrepo_t *conf_add_repo(conf_t *conf, const char *name) {
+    confrepo_t *repo;
+
+    if((repo = conf_repo(conf, name))) {
+        return repo;
+    }
+    if(conf->nrepos == conf->size) {
+        conf->size = conf->size ? conf->size * 2 : 16;
+        conf->repos = realloc(conf->repos, conf->size * sizeof(confrepo_t));
+    }
+    repo = conf->repos + conf->nrepos++;
+    repo->name = strdup(name);
+    repo->siglevel = 0;
+    repo->sigset = 0;
+    repo->usage = 0;
+    return repo;
+}
+
+/* SigLevel words change the package or database half of the level, or both,
+ * and within it either whether signatures are checked or which keys are
+ * trusted; *set records the bits a repository gave itself, like pacman's
+ * *_SET and *_TRUST_SET flags */
+void conf_siglevel(char *value, alpm_siglevel_t *level, int *set, const char *file, int line) {
+    char *word;
+
+    for(word = strtok(value, " \t"); word; word = strtok(NULL, " \t")) {
+        int mask = SIG_PACKAGE_ALL | SIG_DATABASE_ALL;
+        int lvl = *level;
+
+        if(strncmp(word, "Package", 7) == 0) {
+            mask = SIG_PACKAGE_ALL;
+            word += 7;
+        } else if(strncmp(word, "Database", 8) == 0) {
+            mask = SIG_DATABASE_ALL;
+            word += 8;
+        }
+
+        if(strcmp(word, "Never") == 0) {
+            lvl &= ~(mask & (ALPM_SIG_PACKAGE | ALPM_SIG_DATABASE));
+            mask &= SIG_VERIFY;
+        } else if(strcmp(word, "Optional") == 0) {
+            lvl |= mask & SIG_VERIFY;
+            mask &= SIG_VERIFY;
+        } else if(strcmp(word, "Required") == 0) {
+            lvl |= mask & (ALPM_SIG_PACKAGE | ALPM_SIG_DATABASE);
+            lvl &= ~(mask & (ALPM_SIG_PACKAGE_OPTIONAL | ALPM_SIG_DATABASE_OPTIONAL));
+            mask &= SIG_VERIFY;
+        } else if(strcmp(word, "TrustedOnly") == 0) {
+            lvl &= ~(mask & SIG_TRUST);
+            mask &= SIG_TRUST;
+        } else if(strcmp(word, "TrustAll") == 0) {
+            lvl |= mask & SIG_TRUST;
+            mask &= SIG_TRUST;
+        } else {
+            fprintf(stderr, "warning: %s:%d: invalid SigLevel '%s'\n", file, line, word);
+            continue;
+        }
+        *level = lvl;
+        if(set) {
+            *set |= mask;
+        }
+    }
+}
+
+int conf_usage(char *value, const char *file, int line) {
+    static const char *names[] = { "Sync", "Search", "Install", "Upgrade", "All" };
+    static const int usages[] = { ALPM_DB_USAGE_SYNC, ALPM_DB_USAGE_SEARCH,
+        ALPM_DB_USAGE_INSTALL, ALPM_DB_USAGE_UPGRADE, ALPM_DB_USAGE_ALL };
+    int usage = 0;
+    char *word;
+    size_t i;
+
+    for(word = strtok(value, " \t"); word; word = strtok(NULL, " \t")) {
+        for(i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if(strcmp(word, names[i]) == 0) {
+                usage |= usages[i];
+                break;
+            }
+        }
+        if(i == sizeof(names) / sizeof(names[0])) {
+            fprintf(stderr, "warning: %s:%d: invalid Usage '%s'\n", file, line, word);
+        }
+    }
+    return usage;
+}
+
+int conf_parse(conf_t *conf, const char *path, long *section, int depth);
+
+/* an Include continues the section it appears in, so a mirrorlist adds its
+ * servers to the repository that includes it */
+int conf_include(conf_t *conf, const char *pattern, long *section, int depth,
+        const char *file, int line) {
+    glob_t files;
+    size_t i;
+    int ret = 0;
+
+    if(depth >= CONF_MAX_DEPTH) {
+        fprintf(stderr, "error: %s:%d: includes nested too deeply\n", file, line);
+        return -1;
+    }
+    if(glob(pattern, 0, NULL, &files) != 0) {
+        fprintf(stderr, "warning: %s:%d: no files match '%s'\n", file, line, pattern);
+        return 0;
+    }
+    for(i = 0; i < files.gl_pathc && ret == 0; i++) {
+        ret = conf_parse(conf, files.gl_pathv[i], section, depth + 1);
+    }
+    globfree(&files);
+    return ret;
+}
+
+/* section is the index of the current repository, or -1 in [options] */
+int conf_parse(conf_t *conf, const char *path, long *section, int depth) {
+    FILE *fp;
+    char *buf = NULL;
+    size_t size = 0;
+    int line = 0, ret = 0;
+
+    if((fp = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "error: could not read %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while(ret == 0 && getline(&buf, &size, fp) != -1) {
+        char *key, *value, *ptr;
+        size_t len;
+
+        line++;
+        if((ptr = strchr(buf, '#'))) {
+            *ptr = '\0';
+        }
+        key = conf_trim(buf);
+        len = strlen(key);
+        if(len == 0) {
+            continue;
+        }
+
+        if(key[0] == '[' && key[len - 1] == ']') {
+            key[len - 1] = '\0';
+            key = conf_trim(key + 1);
+            if(strcmp(key, "options") == 0) {
+                *section = -1;
+            } else if(*key) {
+                *section = conf_add_repo(conf, key) - conf->repos;
+            } else {
+                fprintf(stderr, "error: %s:%d: empty section name\n", path, line);
+                ret = -1;
+            }
+            continue;
+        }
+
+        if((value = strchr(key, '='))) {
+            *value++ = '\0';
+            key = conf_trim(key);
+            value = conf_trim(value);
+        }
+
+        if(value && strcmp(key, "Include") == 0) {
+            ret = conf_include(conf, value, section, depth, path, line);
+        } else if(value && strcmp(key, "SigLevel") == 0) {
+            if(*section < 0) {
+                conf_siglevel(value, &conf->siglevel, NULL, path, line);
+            } else {
+                confrepo_t *repo = conf->repos + *section;
+                conf_siglevel(value, &repo->siglevel, &repo->sigset, path, line);
+            }
+        } else if(value && *section >= 0 && strcmp(key, "Usage") == 0) {
+            conf->repos[*section].usage |= conf_usage(value, path, line);
+        } else if(value && *section < 0 && strcmp(key, "RootDir") == 0) {
+            free(conf->rootdir);
+            conf->rootdir = strdup(value);
+        } else if(value && *section < 0 && strcmp(key, "DBPath") == 0) {
+            free(conf->dbpath);
+            conf->dbpath = strdup(value);
+        }
+    }
+
+    free(buf);
+    fclose(fp);
+    return ret;
+}
+
+conf_t *conf_load(const char *path) {
+    conf_t *conf = calloc(1, sizeof(conf_t));
+    long section = -1;
+    size_t r;
+
+    conf->siglevel = ALPM_SIG_PACKAGE | ALPM_SIG_PACKAGE_OPTIONAL
+        | ALPM_SIG_DATABASE | ALPM_SIG_DATABASE_OPTIONAL;
+
+    if(conf_parse(conf, path, &section, 0) != 0) {
+        conf_free(conf);
+        return NULL;
+    }
+
+    /* as in pacman, the database path follows the root unless it is set */
+    if(conf->rootdir == NULL || *conf->rootdir == '\0') {
+        free(conf->rootdir);
+        conf->rootdir = strdup("/");
+    } else if(conf->dbpath == NULL) {
+        size_t len = strlen(conf->rootdir) + sizeof("/var/lib/pacman/");
+        conf->dbpath = malloc(len);
+        snprintf(conf->dbpath, len, "%s%svar/lib/pacman/", conf->rootdir,
+                conf->rootdir[strlen(conf->rootdir) - 1] == '/' ? "" : "/");
+    }
+    if(conf->dbpath == NULL) {
+        conf->dbpath = strdup("/var/lib/pacman/");
+    }
+
+    /* repositories take the default for whatever their SigLevel left out */
+    for(r = 0; r < conf->nrepos; r++) {
+        confrepo_t *repo = conf->repos + r;
+        repo->siglevel = (conf->siglevel & ~repo->sigset) | (repo->siglevel & repo->sigset);
+        if(repo->usage == 0) {
+            repo->usage = ALPM_DB_USAGE_ALL;
+        }
+    }
+
+    return conf;
+}
+
+void conf_free(conf_t *conf) {
+    size_t r;
+
+    if(conf == NULL) {
+        return;
+    }
+    for(r = 0; r < conf->nrepos; r++) {
+        free(conf->repos[r].name);
+    }
+    free(conf->repos);
+    free(conf->rootdir);
+    free(conf->dbpath);
+    free(conf);
+}
@@ -0,0 +1,38 @@
+#ifndef PACFIND_CONF_H
+#define PACFIND_CONF_H
+
+#include <stddef.h>
+
+#include <alpm.h>
+
+#define CONF_FILE "/etc/pacman.conf"
+
+/* a repository section of pacman.conf; servers are not needed to read the
+ * databases and are not kept */
+typedef struct confrepo_t {
+    char *name;
+    alpm_siglevel_t siglevel;
+    int sigset;
+    int usage;
+} confrepo_t;
+
+/* the parts of pacman.conf, with its includes, that decide which databases
+ * there are and where they live */
+typedef struct conf_t {
+    char *rootdir;
+    char *dbpath;
+    alpm_siglevel_t siglevel;
+
+    confrepo_t *repos;
+    size_t nrepos;
+    size_t size;
+} conf_t;
+
+/* reads path and the files it includes; prints what went wrong and returns
+ * NULL if it cannot be read */
+conf_t *conf_load(const char *path);
+void conf_free(conf_t *conf);
+
+confrepo_t *conf_repo(const conf_t *conf, const char *name);
+
+#endif /* PACFIND_CONF_H */
@@ -0,0 +1,475 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "daemon.h"
+
+/* a query being answered by a child; the daemon sends the exit status on
+ * fd once the child is gone */
+typedef struct conn_t {
+    pid_t pid;
+    int fd;
+} conn_t;
+
+int daemon_socket_path(char *path, size_t size) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    int len;
+
+    if(dir && *dir) {
+        len = snprintf(path, size, "%s/pacfind.sock", dir);
+    } else {
+        len = snprintf(path, size, "/tmp/pacfind-%d.sock", (int) getuid());
+    }
+    return len < 0 || (size_t) len >= size ? -1 : 0;
+}
+
+int daemon_addr(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int daemon_connect(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if(daemon_addr(path, &addr) != 0) {
+        return -1;
+    }
+    if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        return -1;
+    }
+    if(connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int daemon_listen(const char *path) {
+    struct sockaddr_un addr;
+    mode_t mask;
+    int fd;
+
+    /* never take over the socket of a running daemon, but replace one left
+     * behind by a daemon that died */
+    if((fd = daemon_connect(path)) >= 0) {
+        close(fd);
+        errno = EADDRINUSE;
+        return -1;
+    }
+    if(daemon_addr(path, &addr) != 0) {
+        return -1;
+    }
+    unlink(path);
+
+    if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        return -1;
+    }
+    mask = umask(077);
+    if(bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        umask(mask);
+        close(fd);
+        return -1;
+    }
+    umask(mask);
+    return fd;
+}
+
+int daemon_write(int fd, const void *buf, size_t len) {
+    while(len) {
+        ssize_t n = write(fd, buf, len);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return -1;
+        }
+        buf = (const char*) buf + n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* the client's standard output and error go to the child with the first
+ * byte of the request, so the child writes to them directly and only the
+ * exit status comes back over the socket */
+int daemon_send_fds(int fd) {
+    int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+    char cbuf[CMSG_SPACE(sizeof(fds))], byte = 0;
+    struct iovec iov = { &byte, 1 };
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    while(sendmsg(fd, &msg, MSG_NOSIGNAL) != 1) {
+        if(errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* receives the client's standard output and error into fds */
+int daemon_recv_fds(int fd, int *fds) {
+    char cbuf[CMSG_SPACE(2 * sizeof(int))], byte;
+    struct iovec iov = { &byte, 1 };
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    while((n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if(n != 1 || (msg.msg_flags & MSG_CTRUNC) || cmsg == NULL
+            || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+            || cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), 2 * sizeof(int));
+    return 0;
+}
+
+/* a request is the client's standard output and error, then the argument
+ * count, the arguments, the text of a --batch (empty without one) and the
+ * names read from standard input, each terminated by a NUL byte; the end of
+ * the names is the end of the stream */
+int daemon_send(int fd, int argc, char **argv, const char *batch, nameset_t *names) {
+    char count[16];
+    size_t n;
+    int i;
+
+    if(daemon_send_fds(fd) != 0) {
+        return -1;
+    }
+    snprintf(count, sizeof(count), "%d", argc);
+    if(daemon_write(fd, count, strlen(count) + 1) != 0) {
+        return -1;
+    }
+    for(i = 0; i < argc; i++) {
+        if(daemon_write(fd, argv[i], strlen(argv[i]) + 1) != 0) {
+            return -1;
+        }
+    }
+    if(daemon_write(fd, batch ? batch : "", batch ? strlen(batch) + 1 : 1) != 0) {
+        return -1;
+    }
+    for(n = 0; names && n < names->count; n++) {
+        if(daemon_write(fd, names->strs[n], strlen(names->strs[n]) + 1) != 0) {
+            return -1;
+        }
+    }
+    return shutdown(fd, SHUT_WR);
+}
+
+/* reads a request; argv points into the returned buffer */
+char *daemon_recv(int fd, int *argc, char ***argv, char **batch, nameset_t **names) {
+    size_t len = 0, size = 4096;
+    char *buf = malloc(size), *p, *end;
+    ssize_t n;
+    long count;
+    int i;
+
+    while((n = read(fd, buf + len, size - len)) != 0) {
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            free(buf);
+            return NULL;
+        }
+        len += n;
+        if(len == size) {
+            size *= 2;
+            buf = realloc(buf, size);
+        }
+    }
+    if(len == 0 || buf[len - 1] != '\0') {
+        free(buf);
+        return NULL;
+    }
+
+    end = buf + len;
+    count = strtol(buf, &p, 10);
+    if(*p || count < 1 || count > (long) len) {
+        free(buf);
+        return NULL;
+    }
+    p++;
+
+    *argc = count;
+    *argv = malloc((count + 1) * sizeof(char*));
+    for(i = 0; i < count; i++) {
+        if(p == end) {
+            free(*argv);
+            free(buf);
+            return NULL;
+        }
+        (*argv)[i] = p;
+        p += strlen(p) + 1;
+    }
+    (*argv)[count] = NULL;
+    if(p == end) {
+        free(*argv);
+        free(buf);
+        return NULL;
+    }
+    *batch = p;
+    p += strlen(p) + 1;
+
+    *names = NULL;
+    for(; p < end; p += strlen(p) + 1) {
+        if(*names == NULL) {
+            *names = nameset_new();
+        }
+        nameset_add(*names, p, strlen(p));
+    }
+    return buf;
+}
+
+/* the socket, and the process listening on it, must belong to the caller
+ * or to root: without XDG_RUNTIME_DIR the socket sits at a predictable path
+ * in /tmp, where any user could have created it first */
+int daemon_trusted(const char *path, int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    uid_t uid = getuid();
+    struct stat st;
+
+    if(lstat(path, &st) != 0 || !S_ISSOCK(st.st_mode)
+            || (st.st_uid != uid && st.st_uid != 0)) {
+        return 0;
+    }
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0
+            || (cred.uid != uid && cred.uid != 0)) {
+        return 0;
+    }
+    return 1;
+}
+
+/* the reply is a single byte, the exit status, sent by the daemon once the
+ * child is gone; a reply without it means the daemon went away while the
+ * query ran, after some of the output may already have been written */
+int daemon_query(const char *path, int argc, char **argv, const char *batch, nameset_t *names) {
+    unsigned char code;
+    ssize_t n;
+    int fd;
+
+    if((fd = daemon_connect(path)) < 0) {
+        return -1;
+    }
+    if(!daemon_trusted(path, fd)) {
+        fprintf(stderr, "warning: ignoring %s, which belongs to another user\n", path);
+        close(fd);
+        return -1;
+    }
+    if(daemon_send(fd, argc, argv, batch, names) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    while((n = read(fd, &code, 1)) < 0 && errno == EINTR);
+    close(fd);
+    if(n != 1) {
+        fprintf(stderr, "error: the daemon at %s did not finish the query\n", path);
+        return DAEMON_LOST;
+    }
+    return code;
+}
+
+void daemon_reap(conn_t *conns, size_t *nconns) {
+    pid_t pid;
+    int status;
+    size_t i;
+
+    while((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for(i = 0; i < *nconns; i++) {
+            if(conns[i].pid == pid) {
+                unsigned char code = WIFEXITED(status)
+                    ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                daemon_write(conns[i].fd, &code, 1);
+                close(conns[i].fd);
+                conns[i] = conns[--*nconns];
+                break;
+            }
+        }
+    }
+}
+
+void daemon_child(int fd, serve_fn serve, void *ctx) {
+    nameset_t *names;
+    char **argv, *batch;
+    int argc, fds[2], status;
+
+    signal(SIGPIPE, SIG_DFL);
+    if(daemon_recv_fds(fd, fds) != 0
+            || daemon_recv(fd, &argc, &argv, &batch, &names) == NULL) {
+        _exit(DAEMON_LOST);
+    }
+    close(fd);
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+
+    status = serve(ctx, argc, argv, batch, names);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(status);
+}
+
+int daemon_watch(int ifd, const char *dbpath, const char *sub) {
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+        | IN_CLOSE_WRITE | IN_ATTRIB;
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s%s", dbpath, sub);
+    return inotify_add_watch(ifd, path, mask);
+}
+
+/* every connection is answered by a forked child, which sees the loaded
+ * databases as they were when it was forked; the databases are refreshed in
+ * the daemon once pacman is done with them */
+int daemon_serve(const char *path, const char *dbpath,
+        serve_fn serve, refresh_fn refresh, void *ctx) {
+    conn_t *conns = NULL;
+    size_t nconns = 0, size = 0;
+    sigset_t mask, old;
+    char lock[4096];
+    int lfd, ifd, sfd, pending = 0;
+
+    snprintf(lock, sizeof(lock), "%s/db.lck", dbpath);
+
+    if((lfd = daemon_listen(path)) < 0) {
+        return -1;
+    }
+    if((ifd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) < 0) {
+        close(lfd);
+        return -1;
+    }
+    daemon_watch(ifd, dbpath, "");
+    daemon_watch(ifd, dbpath, "/sync");
+    daemon_watch(ifd, dbpath, "/local");
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &old);
+    if((sfd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK)) < 0) {
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        close(ifd);
+        close(lfd);
+        return -1;
+    }
+    /* a client may go away before its exit status is sent */
+    signal(SIGPIPE, SIG_IGN);
+
+    for(;;) {
+        struct pollfd fds[3] = {
+            { lfd, POLLIN, 0 },
+            { ifd, POLLIN, 0 },
+            { sfd, POLLIN, 0 }
+        };
+        int n = poll(fds, 3, pending ? DAEMON_SETTLE_MS : -1);
+
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if(n == 0) {
+            if(access(lock, F_OK) != 0) {
+                refresh(ctx);
+                pending = 0;
+            }
+            continue;
+        }
+
+        if(fds[1].revents) {
+            char buf[4096];
+            while(read(ifd, buf, sizeof(buf)) > 0);
+            pending = 1;
+        }
+
+        if(fds[2].revents) {
+            struct signalfd_siginfo si;
+            while(read(sfd, &si, sizeof(si)) > 0);
+            daemon_reap(conns, &nconns);
+        }
+
+        if(fds[0].revents) {
+            int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+            pid_t pid;
+
+            if(cfd < 0) {
+                continue;
+            }
+            /* the child must not write out what the daemon left buffered */
+            fflush(NULL);
+            if((pid = fork()) == 0) {
+                size_t i;
+                for(i = 0; i < nconns; i++) {
+                    close(conns[i].fd);
+                }
+                close(lfd);
+                close(ifd);
+                close(sfd);
+                sigprocmask(SIG_SETMASK, &old, NULL);
+                daemon_child(cfd, serve, ctx);
+            }
+            if(pid < 0) {
+                close(cfd);
+                continue;
+            }
+
+            if(nconns == size) {
+                size = size ? size * 2 : 16;
+                conns = realloc(conns, size * sizeof(conn_t));
+            }
+            conns[nconns].pid = pid;
+            conns[nconns].fd = cfd;
+            nconns++;
+        }
+    }
+
+    free(conns);
+    close(sfd);
+    close(ifd);
+    close(lfd);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return -1;
+}
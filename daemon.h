@@ -0,0 +1,38 @@
+#ifndef PACFIND_DAEMON_H
+#define PACFIND_DAEMON_H
+
+#include <stddef.h>
+
+#include "nameset.h"
+
+/* runs one query in a child forked for the connection, with the client's
+ * standard output and error; batch is the text the client read for
+ * --batch.  Returns the exit status */
+typedef int (*serve_fn) (void *ctx, int argc, char **argv, const char *batch, nameset_t *names);
+
+/* called once changes below the database path have settled */
+typedef void (*refresh_fn) (void *ctx);
+
+/* how long the database path must be quiet, and unlocked, before a change
+ * is acted on */
+#define DAEMON_SETTLE_MS 200
+
+/* the exit status of a query the daemon did not see through, either because
+ * the request was cut short or because the daemon went away */
+#define DAEMON_LOST 2
+
+int daemon_socket_path(char *path, size_t size);
+
+/* serves queries on the socket at path until killed, watching dbpath for
+ * changes; returns only if setting up fails */
+int daemon_serve(const char *path, const char *dbpath,
+        serve_fn serve, refresh_fn refresh, void *ctx);
+
+/* sends a query, and the text of its --batch if there is one, to the
+ * daemon at path, which writes its output to this process's standard output
+ * and error; returns the query's exit status, DAEMON_LOST if the daemon
+ * went away before finishing it, or -1 if no daemon answered or the daemon
+ * is not run by the caller or root */
+int daemon_query(const char *path, int argc, char **argv, const char *batch, nameset_t *names);
+
+#endif /* PACFIND_DAEMON_H */
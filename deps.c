@@ -0,0 +1,442 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "alpm.h"
+
+#include "bitset.h"
+#include "deps.h"
+#include "snapshot.h"
+
+uint32_t strhash(const char *str, size_t len) {
+    uint32_t hash = 2166136261u;
+    size_t i;
+    for(i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char) str[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void satindex_add(satindex_t *idx, size_t *size, const char *name,
+        const char *version, alpm_depmod_t mod, uint32_t id, int provision) {
+    satentry_t *e;
+
+    if(idx->nentries == *size) {
+        *size = *size ? *size * 2 : 1024;
+        idx->entries = realloc(idx->entries, *size * sizeof(satentry_t));
+    }
+
+    e = idx->entries + idx->nentries++;
+    e->name = name;
+    e->version = version;
+    e->mod = mod;
+    e->id = id;
+    e->provision = provision;
+    e->hash = strhash(name, strlen(name));
+    e->next = -1;
+}
+
+satindex_t *satindex_new(const snapshot_t *snap, const bitset_t *include) {
+    satindex_t *idx = calloc(1, sizeof(satindex_t));
+    size_t size = 0, i, id;
+
+    for(id = 0; id < snap->count; id++) {
+        const snapitem_t *prov;
+        size_t nprov;
+        if(include && !bitset_test(include, id)) {
+            continue;
+        }
+        satindex_add(idx, &size, snap_str(snap, SCOL_NAME, id),
+                snap_str(snap, SCOL_VERSION, id), ALPM_DEP_MOD_EQ, id, 0);
+        prov = snap_list(snap, LCOL_PROVIDES, id, &nprov);
+        for(i = 0; i < nprov; i++) {
+            satindex_add(idx, &size, snap_item_str(snap, id, prov[i].str),
+                    snap_item_str(snap, id, prov[i].version), prov[i].mod, id, 1);
+        }
+    }
+
+    for(idx->nbuckets = 64; idx->nbuckets < idx->nentries * 2; idx->nbuckets *= 2);
+    idx->buckets = malloc(idx->nbuckets * sizeof(int32_t));
+    memset(idx->buckets, 0xff, idx->nbuckets * sizeof(int32_t));
+
+    /* push onto the front of each chain from the back so that candidates
+     * are visited in package order, like alpm_find_satisfier */
+    for(i = idx->nentries; i-- > 0; ) {
+        satentry_t *e = idx->entries + i;
+        size_t b = e->hash & (idx->nbuckets - 1);
+        e->next = idx->buckets[b];
+        idx->buckets[b] = i;
+    }
+
+    return idx;
+}
+
+void satindex_free(satindex_t *idx) {
+    if(idx == NULL) {
+        return;
+    }
+    free(idx->buckets);
+    free(idx->entries);
+    free(idx);
+}
+
+int dep_vercmp(const char *version1, alpm_depmod_t mod, const char *version2) {
+    int cmp;
+
+    if(mod == ALPM_DEP_MOD_ANY) {
+        return 1;
+    }
+    if(version1 == NULL || version2 == NULL) {
+        return 0;
+    }
+
+    cmp = alpm_pkg_vercmp(version1, version2);
+    switch(mod) {
+        case ALPM_DEP_MOD_EQ: return cmp == 0;
+        case ALPM_DEP_MOD_GE: return cmp >= 0;
+        case ALPM_DEP_MOD_LE: return cmp <= 0;
+        case ALPM_DEP_MOD_LT: return cmp < 0;
+        case ALPM_DEP_MOD_GT: return cmp > 0;
+        default: return 1;
+    }
+}
+
+int satentry_satisfies(satentry_t *e, alpm_depmod_t mod, const char *version) {
+    if(!e->provision) {
+        return dep_vercmp(e->version, mod, version);
+    }
+    /* an unversioned provision only satisfies unversioned dependencies */
+    return mod == ALPM_DEP_MOD_ANY
+        || (e->mod == ALPM_DEP_MOD_EQ && dep_vercmp(e->version, mod, version));
+}
+
+long satindex_lookup(satindex_t *idx, const char *name, size_t len,
+        alpm_depmod_t mod, const char *version) {
+    uint32_t hash = strhash(name, len);
+    int32_t i, first = idx->buckets[hash & (idx->nbuckets - 1)];
+
+    /* packages with a matching name take precedence over providers */
+    for(i = first; i >= 0; i = idx->entries[i].next) {
+        satentry_t *e = idx->entries + i;
+        if(!e->provision && e->hash == hash && strncmp(e->name, name, len) == 0
+                && e->name[len] == '\0' && satentry_satisfies(e, mod, version)) {
+            return e->id;
+        }
+    }
+
+    for(i = first; i >= 0; i = idx->entries[i].next) {
+        satentry_t *e = idx->entries + i;
+        if(e->provision && e->hash == hash && strncmp(e->name, name, len) == 0
+                && e->name[len] == '\0' && satentry_satisfies(e, mod, version)) {
+            return e->id;
+        }
+    }
+
+    return -1;
+}
+
+long satindex_find(satindex_t *idx, const char *name, alpm_depmod_t mod, const char *version) {
+    return satindex_lookup(idx, name, strlen(name), mod, version);
+}
+
+long satindex_find_item(satindex_t *idx, const snapshot_t *snap, size_t id, const snapitem_t *item) {
+    return satindex_lookup(idx, snap_item_str(snap, id, item->str), item->len,
+            item->mod, snap_item_str(snap, id, item->version));
+}
+
+/* finds a package by name, ignoring provisions */
+long satindex_find_pkg(satindex_t *idx, const char *name) {
+    uint32_t hash = strhash(name, strlen(name));
+    int32_t i = idx->buckets[hash & (idx->nbuckets - 1)];
+
+    for(; i >= 0; i = idx->entries[i].next) {
+        satentry_t *e = idx->entries + i;
+        if(!e->provision && e->hash == hash && strcmp(e->name, name) == 0) {
+            return e->id;
+        }
+    }
+
+    return -1;
+}
+
+/* accepts "name", "name<op>version" and optdepends style "name: description" */
+long satindex_find_string(satindex_t *idx, const char *depstring) {
+    const char *end = strstr(depstring, ": ");
+    const char *op;
+    size_t len = end ? (size_t) (end - depstring) : strlen(depstring);
+    alpm_depmod_t mod = ALPM_DEP_MOD_ANY;
+    char version[256];
+    size_t oplen = 1;
+
+    for(op = depstring; op < depstring + len; op++) {
+        if(*op == '<' || *op == '>' || *op == '=') {
+            break;
+        }
+    }
+
+    if(op == depstring + len) {
+        return satindex_lookup(idx, depstring, len, mod, NULL);
+    }
+
+    if(op[1] == '=') {
+        mod = op[0] == '<' ? ALPM_DEP_MOD_LE : ALPM_DEP_MOD_GE;
+        oplen = 2;
+    } else {
+        mod = op[0] == '<' ? ALPM_DEP_MOD_LT
+            : op[0] == '>' ? ALPM_DEP_MOD_GT : ALPM_DEP_MOD_EQ;
+    }
+
+    if(len - (op - depstring) - oplen >= sizeof(version)) {
+        return -1;
+    }
+    memcpy(version, op + oplen, len - (op - depstring) - oplen);
+    version[len - (op - depstring) - oplen] = '\0';
+
+    return satindex_lookup(idx, depstring, op - depstring, mod, version);
+}
+
+void depgraph_free(depgraph_t *graph) {
+    if(graph == NULL) {
+        return;
+    }
+    free(graph->offsets);
+    free(graph->edges);
+    free(graph);
+}
+
+/* forward edges from each package to the selected satisfier of each of its
+ * dependencies */
+depgraph_t *depgraph_depends(const snapshot_t *snap, satindex_t *satisfiers) {
+    depgraph_t *graph = calloc(1, sizeof(depgraph_t));
+    size_t count = snap->count;
+    uint32_t *seen = malloc((count ? count : 1) * sizeof(uint32_t));
+    size_t size = 1024, nedges = 0, id, i;
+
+    memset(seen, 0xff, (count ? count : 1) * sizeof(uint32_t));
+    graph->count = count;
+    graph->offsets = malloc((count + 1) * sizeof(uint32_t));
+    graph->edges = malloc(size * sizeof(uint32_t));
+
+    for(id = 0; id < count; id++) {
+        size_t ndeps;
+        const snapitem_t *deps = snap_list(snap, LCOL_DEPENDS, id, &ndeps);
+        graph->offsets[id] = nedges;
+        for(i = 0; i < ndeps; i++) {
+            long s = satindex_find_item(satisfiers, snap, id, deps + i);
+            if(s < 0 || seen[s] == id) {
+                continue;
+            }
+            seen[s] = id;
+            if(nedges == size) {
+                size *= 2;
+                graph->edges = realloc(graph->edges, size * sizeof(uint32_t));
+            }
+            graph->edges[nedges++] = s;
+        }
+    }
+    graph->offsets[count] = nedges;
+
+    free(seen);
+    return graph;
+}
+
+/* reverse edges from each package to every package that has a dependency
+ * it satisfies; like alpm_pkg_compute_requiredby() local packages are only
+ * required by local packages and sync packages by sync packages */
+depgraph_t *depgraph_requiredby(const snapshot_t *snap) {
+    depgraph_t *graph = calloc(1, sizeof(depgraph_t));
+    size_t count = snap->count;
+    satindex_t *providers = satindex_new(snap, NULL);
+    uint32_t *seen = malloc((count ? count : 1) * sizeof(uint32_t));
+    uint32_t *targets = NULL, *sources = NULL, *fill;
+    size_t size = 0, npairs = 0, id, i;
+
+    memset(seen, 0xff, (count ? count : 1) * sizeof(uint32_t));
+    graph->count = count;
+    graph->offsets = calloc(count + 1, sizeof(uint32_t));
+
+    for(id = 0; id < count; id++) {
+        int local = snap_local(snap, id);
+        size_t ndeps;
+        const snapitem_t *deps = snap_list(snap, LCOL_DEPENDS, id, &ndeps);
+        for(i = 0; i < ndeps; i++) {
+            const char *name = snap_item_str(snap, id, deps[i].str);
+            const char *version = snap_item_str(snap, id, deps[i].version);
+            uint32_t hash = strhash(name, deps[i].len);
+            int32_t e = providers->buckets[hash & (providers->nbuckets - 1)];
+            for(; e >= 0; e = providers->entries[e].next) {
+                satentry_t *entry = providers->entries + e;
+                if(entry->hash != hash || strcmp(entry->name, name) != 0
+                        || seen[entry->id] == id
+                        || snap_local(snap, entry->id) != local
+                        || !satentry_satisfies(entry, deps[i].mod, version)) {
+                    continue;
+                }
+                seen[entry->id] = id;
+                if(npairs == size) {
+                    size = size ? size * 2 : 1024;
+                    targets = realloc(targets, size * sizeof(uint32_t));
+                    sources = realloc(sources, size * sizeof(uint32_t));
+                }
+                targets[npairs] = entry->id;
+                sources[npairs] = id;
+                npairs++;
+                graph->offsets[entry->id + 1]++;
+            }
+        }
+    }
+
+    for(i = 0; i < count; i++) {
+        graph->offsets[i + 1] += graph->offsets[i];
+    }
+
+    graph->edges = malloc((npairs ? npairs : 1) * sizeof(uint32_t));
+    fill = malloc((count ? count : 1) * sizeof(uint32_t));
+    memcpy(fill, graph->offsets, count * sizeof(uint32_t));
+    for(i = 0; i < npairs; i++) {
+        graph->edges[fill[targets[i]]++] = sources[i];
+    }
+
+    free(fill);
+    free(targets);
+    free(sources);
+    free(seen);
+    satindex_free(providers);
+    return graph;
+}
+
+#define CLOSURE_NONE UINT32_MAX
+
+closure_t *closure_new(size_t count, const bitset_t *include) {
+    closure_t *closure = calloc(1, sizeof(closure_t));
+    size_t n = count ? count : 1;
+
+    closure->count = count;
+    closure->include = include;
+    closure->comp = malloc(n * sizeof(uint32_t));
+    closure->index = malloc(n * sizeof(uint32_t));
+    closure->lowlink = malloc(n * sizeof(uint32_t));
+    closure->stack = malloc(n * sizeof(uint32_t));
+    closure->calls = malloc(n * sizeof(uint32_t));
+    closure->callpos = malloc(n * sizeof(uint32_t));
+    closure->reach = malloc(n);
+    closure->visible = malloc(n);
+    memset(closure->comp, 0xff, n * sizeof(uint32_t));
+    memset(closure->index, 0xff, n * sizeof(uint32_t));
+
+    return closure;
+}
+
+void closure_free(closure_t *closure) {
+    if(closure == NULL) {
+        return;
+    }
+    free(closure->comp);
+    free(closure->index);
+    free(closure->lowlink);
+    free(closure->stack);
+    free(closure->calls);
+    free(closure->callpos);
+    free(closure->reach);
+    free(closure->visible);
+    free(closure);
+}
+
+/* members are stack[first] through stack[last - 1]; every component they
+ * have edges into is already complete because tarjan finishes components
+ * in reverse topological order */
+void closure_finish(closure_t *closure, depgraph_t *graph, uint32_t first,
+        uint32_t last, hit_fn hit, void *ctx) {
+    uint32_t c = closure->ncomps++, i, e;
+    int down = 0, cyclic = last - first > 1, any = 0;
+
+    for(i = first; i < last; i++) {
+        closure->comp[closure->stack[i]] = c;
+    }
+
+    for(i = first; i < last; i++) {
+        uint32_t v = closure->stack[i];
+        for(e = graph->offsets[v]; e < graph->offsets[v + 1]; e++) {
+            uint32_t w = graph->edges[e];
+            if(closure->include && !bitset_test(closure->include, w)) {
+                continue;
+            }
+            if(closure->comp[w] == c) {
+                cyclic = 1;
+            } else if(closure->visible[closure->comp[w]]) {
+                down = 1;
+            }
+        }
+    }
+
+    /* members only need to be tested when nothing below already hits */
+    if(!down) {
+        for(i = first; i < last && !any; i++) {
+            uint32_t v = closure->stack[i];
+            if(!closure->include || bitset_test(closure->include, v)) {
+                any = hit(ctx, v);
+            }
+        }
+    }
+
+    closure->reach[c] = down || (cyclic && any);
+    closure->visible[c] = down || any;
+}
+
+int closure_test(closure_t *closure, depgraph_t *graph, size_t id, hit_fn hit, void *ctx) {
+    uint32_t depth = 0, sp = 0;
+
+    if(closure->comp[id] != CLOSURE_NONE) {
+        return closure->reach[closure->comp[id]];
+    }
+
+    closure->calls[depth] = id;
+    closure->callpos[depth] = graph->offsets[id];
+    depth++;
+    closure->index[id] = closure->lowlink[id] = closure->counter++;
+    closure->stack[sp++] = id;
+
+    while(depth) {
+        uint32_t v = closure->calls[depth - 1];
+        uint32_t *e = &closure->callpos[depth - 1];
+        int descended = 0;
+
+        for(; *e < graph->offsets[v + 1]; (*e)++) {
+            uint32_t w = graph->edges[*e];
+            if(closure->include && !bitset_test(closure->include, w)) {
+                continue;
+            }
+            if(closure->index[w] == CLOSURE_NONE) {
+                (*e)++;
+                closure->calls[depth] = w;
+                closure->callpos[depth] = graph->offsets[w];
+                depth++;
+                closure->index[w] = closure->lowlink[w] = closure->counter++;
+                closure->stack[sp++] = w;
+                descended = 1;
+                break;
+            }
+            if(closure->comp[w] == CLOSURE_NONE && closure->index[w] < closure->lowlink[v]) {
+                /* w is still on the stack */
+                closure->lowlink[v] = closure->index[w];
+            }
+        }
+
+        if(descended) {
+            continue;
+        }
+
+        if(closure->lowlink[v] == closure->index[v]) {
+            uint32_t first = sp;
+            while(closure->stack[--first] != v);
+            closure_finish(closure, graph, first, sp, hit, ctx);
+            sp = first;
+        }
+
+        depth--;
+        if(depth && closure->lowlink[v] < closure->lowlink[closure->calls[depth - 1]]) {
+            closure->lowlink[closure->calls[depth - 1]] = closure->lowlink[v];
+        }
+    }
+
+    return closure->reach[closure->comp[id]];
+}
@@ -0,0 +1,75 @@
+#ifndef PACFIND_DEPS_H
+#define PACFIND_DEPS_H
+
+#include <stdint.h>
+
+#include "alpm.h"
+
+#include "bitset.h"
+#include "snapshot.h"
+
+/* maps package names and provisions to the packages that satisfy them */
+typedef struct satentry_t {
+    const char *name;
+    const char *version;
+    uint32_t hash;
+    uint32_t id;
+    int32_t next;
+    int provision;
+    alpm_depmod_t mod;
+} satentry_t;
+
+typedef struct satindex_t {
+    size_t nbuckets;
+    int32_t *buckets;
+    size_t nentries;
+    satentry_t *entries;
+} satindex_t;
+
+/* compressed adjacency lists: the edges of package id are
+ * edges[offsets[id]] through edges[offsets[id + 1] - 1] */
+typedef struct depgraph_t {
+    size_t count;
+    uint32_t *offsets;
+    uint32_t *edges;
+} depgraph_t;
+
+typedef int (*hit_fn) (void *, size_t);
+
+/* memoized answers to "can a package that hits be reached from id by
+ * following one or more edges", computed per strongly connected component
+ * so every package in a query shares the work */
+typedef struct closure_t {
+    size_t count;
+    const bitset_t *include;
+    uint32_t *comp;
+    uint32_t ncomps;
+    unsigned char *reach;
+    unsigned char *visible;
+
+    /* tarjan state */
+    uint32_t counter;
+    uint32_t *index;
+    uint32_t *lowlink;
+    uint32_t *stack;
+    uint32_t *calls;
+    uint32_t *callpos;
+} closure_t;
+
+satindex_t *satindex_new(const snapshot_t *snap, const bitset_t *include);
+void satindex_free(satindex_t *idx);
+
+long satindex_find(satindex_t *idx, const char *name, alpm_depmod_t mod, const char *version);
+long satindex_find_item(satindex_t *idx, const snapshot_t *snap, size_t id, const snapitem_t *item);
+long satindex_find_string(satindex_t *idx, const char *depstring);
+long satindex_find_pkg(satindex_t *idx, const char *name);
+
+depgraph_t *depgraph_depends(const snapshot_t *snap, satindex_t *satisfiers);
+depgraph_t *depgraph_requiredby(const snapshot_t *snap);
+void depgraph_free(depgraph_t *graph);
+
+closure_t *closure_new(size_t count, const bitset_t *include);
+int closure_test(closure_t *closure, depgraph_t *graph, size_t id, hit_fn hit, void *ctx);
+void closure_free(closure_t *closure);
+
+#endif /* PACFIND_DEPS_H */
@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "desc.h"
+
+/* packages without a name sort last */
+int descpkg_cmp(const void *a, const void *b) {
+    const descpkg_t *p1 = a, *p2 = b;
+    size_t len = p1->namelen < p2->namelen ? p1->namelen : p2->namelen;
+    int c;
+
+    if(p1->name == NULL || p2->name == NULL) {
+        return (p1->name == NULL) - (p2->name == NULL);
+    }
+    if((c = memcmp(p1->name, p2->name, len))) {
+        return c;
+    }
+    return p1->namelen < p2->namelen ? -1 : p1->namelen > p2->namelen;
+}
+
+/* the line following %NAME%, which libalpm sorts packages by */
+int descpkg_name(descpkg_t *pkg) {
+    const char *p = pkg->text, *end = p + pkg->len, *nl;
+
+    pkg->name = NULL;
+    pkg->namelen = 0;
+    while(p < end) {
+        if((nl = memchr(p, '\n', end - p)) == NULL) {
+            return -1;
+        }
+        if(nl - p == 6 && memcmp(p, "%NAME%", 6) == 0) {
+            if((end = memchr(nl + 1, '\n', end - nl - 1)) == NULL || end == nl + 1) {
+                return -1;
+            }
+            pkg->name = nl + 1;
+            pkg->namelen = end - pkg->name;
+            return 0;
+        }
+        p = nl + 1;
+    }
+    return -1;
+}
+
+/* splits "name<op>version[: description]" in place, as
+ * alpm_dep_from_string does */
+void desc_add_depend(dbsnap_t *db, listcol_t col, char *str) {
+    snapitem_t *item;
+    char *op, *version = NULL, *desc;
+    int mod = ALPM_DEP_MOD_ANY;
+    uint32_t len;
+
+    if((desc = strstr(str, ": "))) {
+        *desc = '\0';
+    }
+    if((op = strpbrk(str, "<>="))) {
+        if(op[0] == '=') {
+            mod = ALPM_DEP_MOD_EQ;
+        } else if(op[1] == '=') {
+            mod = op[0] == '<' ? ALPM_DEP_MOD_LE : ALPM_DEP_MOD_GE;
+        } else {
+            mod = op[0] == '<' ? ALPM_DEP_MOD_LT : ALPM_DEP_MOD_GT;
+        }
+        version = op + (op[0] != '=' && op[1] == '=' ? 2 : 1);
+        *op = '\0';
+    }
+
+    item = dbsnap_add_item(db, col, str);
+    item->version = dbsnap_intern(db, version, &len);
+    item->mod = mod;
+}
+
+/* parses one package's text in place: every line is terminated where it
+ * ends and handed to the snapshot, which copies it into its arena */
+void desc_parse(dbsnap_t *db, size_t i, const descfield_t *fields, char *p, char *end) {
+    const char *strs[SCOL_COUNT] = { NULL };
+    int field = -1, c;
+    char *nl;
+
+    for(; p < end && (nl = memchr(p, '\n', end - p)); p = nl + 1) {
+        *nl = '\0';
+        if(p == nl) {
+            field = -1;
+        } else if(p[0] == '%' && nl[-1] == '%') {
+            for(field = 0; fields[field].name; field++) {
+                if(strcmp(fields[field].name, p) == 0) {
+                    break;
+                }
+            }
+            if(fields[field].name == NULL) {
+                field = -1;
+            }
+        } else if(field >= 0) {
+            c = fields[field].col;
+            switch(fields[field].kind) {
+                case DESC_STR:
+                    if(strs[c] == NULL) {
+                        strs[c] = p;
+                    }
+                    break;
+                case DESC_NUM:
+                    db->num[c][i] = strtoll(p, NULL, 10);
+                    break;
+                case DESC_LIST:
+                    dbsnap_add_item(db, c, p);
+                    break;
+                case DESC_DEPENDS:
+                    desc_add_depend(db, c, p);
+                    break;
+            }
+        }
+    }
+
+    for(c = 0; c < SCOL_COUNT; c++) {
+        dbsnap_set_str(db, c, i, strs[c]);
+    }
+    for(c = 0; c < LCOL_COUNT; c++) {
+        db->list_start[c][i + 1] = db->list_len[c];
+    }
+}
+
+dbsnap_t *desc_build(const char *dbname, int local, const descfield_t *fields,
+        descpkg_t *pkgs, size_t npkgs) {
+    dbsnap_t *db;
+    size_t i, n;
+
+    /* libalpm drops packages without a name */
+    for(i = 0, n = 0; i < npkgs; i++) {
+        if(descpkg_name(pkgs + i) == 0) {
+            n++;
+        }
+    }
+    qsort(pkgs, npkgs, sizeof(descpkg_t), descpkg_cmp);
+
+    db = dbsnap_new(dbname, local, n);
+    for(i = 0; i < n; i++) {
+        desc_parse(db, i, fields, pkgs[i].text, pkgs[i].text + pkgs[i].len);
+    }
+    return db;
+}
@@ -0,0 +1,38 @@
+#ifndef PACFIND_DESC_H
+#define PACFIND_DESC_H
+
+#include <stddef.h>
+
+#include "snapshot.h"
+
+typedef enum desckind_t {
+    DESC_STR,
+    DESC_NUM,
+    DESC_LIST,
+    DESC_DEPENDS
+} desckind_t;
+
+/* a %SECTION% of a desc file and the column it fills; tables of these end
+ * with a NULL name */
+typedef struct descfield_t {
+    const char *name;
+    desckind_t kind;
+    int col;
+} descfield_t;
+
+/* the text of one package's desc file, and of its depends file in
+ * databases written before the two were merged */
+typedef struct descpkg_t {
+    char *text;
+    size_t len;
+    const char *name;
+    size_t namelen;
+} descpkg_t;
+
+/* builds a dbsnap_t from the packages' texts, which are parsed in place.
+ * Packages without a name are dropped and the rest are ordered by name, as
+ * libalpm orders them; pkgs is reordered, with the dropped ones last */
+dbsnap_t *desc_build(const char *dbname, int local, const descfield_t *fields,
+        descpkg_t *pkgs, size_t npkgs);
+
+#endif /* PACFIND_DESC_H */
@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa.h"
+
+int nfa_state(dfa_t *dfa, nstype_t type, int out, int out1, const uint64_t *set) {
+    nstate_t *s;
+
+    if(dfa->nnfa == dfa->nfa_size) {
+        dfa->nfa_size *= 2;
+        dfa->nfa = realloc(dfa->nfa, dfa->nfa_size * sizeof(nstate_t));
+    }
+    s = dfa->nfa + dfa->nnfa;
+    s->type = type;
+    s->out = out;
+    s->out1 = out1;
+    s->set = set;
+    return dfa->nnfa++;
+}
+
+/* builds the states for node in front of next; the tree may share subtrees,
+ * so every visit creates fresh states */
+int nfa_compile(dfa_t *dfa, int node, int next) {
+    const erenode_t *n = dfa->ere->nodes + node;
+    int s, body;
+
+    switch(n->type) {
+        case ERE_SET:
+            return nfa_state(dfa, NS_SET, next, -1, n->set);
+        case ERE_CAT:
+            return nfa_compile(dfa, n->left, nfa_compile(dfa, n->right, next));
+        case ERE_ALT:
+            s = nfa_compile(dfa, n->left, next);
+            body = nfa_compile(dfa, n->right, next);
+            return nfa_state(dfa, NS_SPLIT, s, body, NULL);
+        case ERE_QUEST:
+            s = nfa_compile(dfa, n->left, next);
+            return nfa_state(dfa, NS_SPLIT, s, next, NULL);
+        case ERE_STAR:
+        case ERE_PLUS:
+            /* the loop state is patched once its body exists; compiling the
+             * body may move the state array */
+            s = nfa_state(dfa, NS_SPLIT, -1, next, NULL);
+            body = nfa_compile(dfa, n->left, s);
+            dfa->nfa[s].out = body;
+            return n->type == ERE_STAR ? s : body;
+        case ERE_BOL:
+            return nfa_state(dfa, NS_BOL, next, -1, NULL);
+        case ERE_EOL:
+            return nfa_state(dfa, NS_EOL, next, -1, NULL);
+        case ERE_EMPTY:
+            return next;
+    }
+    return next;
+}
+
+dfa_t *dfa_compile(const char *pattern, int icase) {
+    ere_t *ere = ere_parse(pattern, icase);
+    dfa_t *dfa;
+
+    if(ere == NULL) {
+        return NULL;
+    }
+
+    dfa = calloc(1, sizeof(dfa_t));
+    dfa->ere = ere;
+    dfa->nfa_size = 16;
+    dfa->nfa = malloc(dfa->nfa_size * sizeof(nstate_t));
+    dfa->start = nfa_compile(dfa, ere->root, nfa_state(dfa, NS_MATCH, -1, -1, NULL));
+
+    dfa->work = malloc(dfa->nnfa * sizeof(int));
+    dfa->stack = malloc(dfa->nnfa * sizeof(int));
+    dfa->mark = calloc(dfa->nnfa, sizeof(uint32_t));
+
+    dfa->nbuckets = 1024;
+    dfa->buckets = malloc(dfa->nbuckets * sizeof(int32_t));
+    memset(dfa->buckets, 0xff, dfa->nbuckets * sizeof(int32_t));
+    dfa->sets_size = 1024;
+    dfa->sets = malloc(dfa->sets_size * sizeof(int));
+    dfa->initial = -1;
+
+    return dfa;
+}
+
+void dfa_free(dfa_t *dfa) {
+    if(dfa == NULL) {
+        return;
+    }
+    ere_free(dfa->ere);
+    free(dfa->nfa);
+    free(dfa->trans);
+    free(dfa->accept);
+    free(dfa->set_off);
+    free(dfa->set_len);
+    free(dfa->sets);
+    free(dfa->buckets);
+    free(dfa->chain);
+    free(dfa->work);
+    free(dfa->stack);
+    free(dfa->mark);
+    free(dfa);
+}
+
+/* adds s and everything reachable from it without consuming input to the
+ * set being built; anchors listed in flags hold at the current position
+ * and are passed through */
+void dfa_closure(dfa_t *dfa, int s, int flags, size_t *len) {
+    size_t top = 0;
+
+    /* states are marked when pushed, so the stack never holds more than
+     * one entry per state */
+    if(dfa->mark[s] == dfa->gen) {
+        return;
+    }
+    dfa->mark[s] = dfa->gen;
+    dfa->stack[top++] = s;
+
+    while(top) {
+        const nstate_t *st = dfa->nfa + dfa->stack[--top];
+        int outs[2] = { st->out, st->out1 };
+        int i;
+
+        switch(st->type) {
+            case NS_SPLIT:
+            case NS_EPS:
+                for(i = st->type == NS_SPLIT ? 1 : 0; i >= 0; i--) {
+                    if(dfa->mark[outs[i]] != dfa->gen) {
+                        dfa->mark[outs[i]] = dfa->gen;
+                        dfa->stack[top++] = outs[i];
+                    }
+                }
+                break;
+            case NS_BOL:
+            case NS_EOL:
+                dfa->work[(*len)++] = st - dfa->nfa;
+                if(flags & (st->type == NS_BOL ? DFA_BOL : DFA_EOL)
+                        && dfa->mark[st->out] != dfa->gen) {
+                    dfa->mark[st->out] = dfa->gen;
+                    dfa->stack[top++] = st->out;
+                }
+                break;
+            default:
+                dfa->work[(*len)++] = st - dfa->nfa;
+                break;
+        }
+    }
+}
+
+int intcmp_asc(const void *a, const void *b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+void dfa_flush(dfa_t *dfa) {
+    dfa->flushes++;
+    dfa->initial = -1;
+    dfa->nstates = 0;
+    dfa->sets_len = 0;
+    memset(dfa->buckets, 0xff, dfa->nbuckets * sizeof(int32_t));
+}
+
+/* finds or adds the state for the len NFA states in work */
+int32_t dfa_intern(dfa_t *dfa, size_t len) {
+    uint32_t hash = 2166136261u;
+    size_t i;
+    int32_t d;
+    int accept = 0;
+
+    qsort(dfa->work, len, sizeof(int), intcmp_asc);
+    for(i = 0; i < len; i++) {
+        hash = (hash ^ dfa->work[i]) * 16777619u;
+    }
+
+    for(d = dfa->buckets[hash % dfa->nbuckets]; d >= 0; d = dfa->chain[d]) {
+        if(dfa->set_len[d] == len
+                && memcmp(dfa->sets + dfa->set_off[d], dfa->work, len * sizeof(int)) == 0) {
+            return d;
+        }
+    }
+
+    /* the cache is full; start over rather than grow without bound */
+    if(dfa->nstates == DFA_MAX_STATES) {
+        dfa_flush(dfa);
+    }
+
+    if(dfa->nstates == dfa->cap) {
+        dfa->cap = dfa->cap ? dfa->cap * 2 : 16;
+        dfa->trans = realloc(dfa->trans, dfa->cap * DFA_SYMBOLS * sizeof(int32_t));
+        dfa->accept = realloc(dfa->accept, dfa->cap);
+        dfa->set_off = realloc(dfa->set_off, dfa->cap * sizeof(uint32_t));
+        dfa->set_len = realloc(dfa->set_len, dfa->cap * sizeof(uint32_t));
+        dfa->chain = realloc(dfa->chain, dfa->cap * sizeof(int32_t));
+    }
+
+    if(dfa->sets_len + len > dfa->sets_size) {
+        while(dfa->sets_len + len > dfa->sets_size) {
+            dfa->sets_size *= 2;
+        }
+        dfa->sets = realloc(dfa->sets, dfa->sets_size * sizeof(int));
+    }
+
+    d = dfa->nstates++;
+    memcpy(dfa->sets + dfa->sets_len, dfa->work, len * sizeof(int));
+    dfa->set_off[d] = dfa->sets_len;
+    dfa->set_len[d] = len;
+    dfa->sets_len += len;
+
+    for(i = 0; i < len; i++) {
+        if(dfa->nfa[dfa->work[i]].type == NS_MATCH) {
+            accept = 1;
+        }
+    }
+    dfa->accept[d] = accept;
+    memset(dfa->trans + (size_t) d * DFA_SYMBOLS, 0xff, DFA_SYMBOLS * sizeof(int32_t));
+
+    dfa->chain[d] = dfa->buckets[hash % dfa->nbuckets];
+    dfa->buckets[hash % dfa->nbuckets] = d;
+    return d;
+}
+
+int32_t dfa_initial(dfa_t *dfa) {
+    size_t len = 0;
+    int32_t d;
+
+    if(dfa->initial >= 0) {
+        return dfa->initial;
+    }
+    dfa->gen++;
+    dfa_closure(dfa, dfa->start, 0, &len);
+    d = dfa_intern(dfa, len);
+    return dfa->initial = d;
+}
+
+/* the search is unanchored, so the start state joins every step; at a
+ * boundary every state stays put and the anchors that hold let their
+ * states advance */
+int32_t dfa_step(dfa_t *dfa, int32_t d, int sym) {
+    size_t i, len = 0;
+    unsigned long flushes = dfa->flushes;
+    const int *set = dfa->sets + dfa->set_off[d];
+    size_t setlen = dfa->set_len[d];
+    int flags = sym < 256 ? 0 : sym - 255;
+    int32_t next;
+
+    dfa->gen++;
+    for(i = 0; i < setlen; i++) {
+        const nstate_t *st = dfa->nfa + set[i];
+
+        if(flags) {
+            dfa_closure(dfa, set[i], flags, &len);
+        } else if(st->type == NS_SET && ere_set_test(st->set, sym)) {
+            dfa_closure(dfa, st->out, 0, &len);
+        }
+    }
+    dfa_closure(dfa, dfa->start, flags, &len);
+
+    next = dfa_intern(dfa, len);
+    /* a flush invalidates d */
+    if(dfa->flushes == flushes) {
+        dfa->trans[(size_t) d * DFA_SYMBOLS + sym] = next;
+    }
+    return next;
+}
+
+#define DFA_NEXT(sym) do { \
+    int32_t t = dfa->trans[(size_t) d * DFA_SYMBOLS + (sym)]; \
+    d = t >= 0 ? t : dfa_step(dfa, d, (sym)); \
+    if(dfa->accept[d]) { \
+        return 1; \
+    } \
+} while(0)
+
+int dfa_exec(dfa_t *dfa, const char *str, size_t len) {
+    const unsigned char *s = (const unsigned char*) str;
+    int32_t d = dfa_initial(dfa);
+    size_t i;
+
+    if(dfa->accept[d]) {
+        return 1;
+    }
+
+    DFA_NEXT(DFA_BOUNDARY(DFA_BOL | (len == 0 || s[0] == '\n' ? DFA_EOL : 0)));
+    for(i = 0; i < len; i++) {
+        int flags = (s[i] == '\n' ? DFA_BOL : 0)
+            | (i + 1 == len || s[i + 1] == '\n' ? DFA_EOL : 0);
+        DFA_NEXT(s[i]);
+        if(flags) {
+            DFA_NEXT(DFA_BOUNDARY(flags));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef PACFIND_DFA_H
+#define PACFIND_DFA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ere.h"
+
+/* positions where ^ or $ can match (around newlines) are fed to the
+ * automaton as extra symbols, one per combination of the two */
+#define DFA_BOL 1
+#define DFA_EOL 2
+#define DFA_BOUNDARY(flags) (255 + (flags))
+#define DFA_SYMBOLS 259
+
+/* most states a dfa keeps before its cache is flushed */
+#define DFA_MAX_STATES 2048
+
+typedef enum nstype_t {
+    NS_SET,
+    NS_BOL,
+    NS_EOL,
+    NS_SPLIT,
+    NS_EPS,
+    NS_MATCH
+} nstype_t;
+
+typedef struct nstate_t {
+    nstype_t type;
+    int out;
+    int out1;
+    const uint64_t *set;
+} nstate_t;
+
+/* a Thompson NFA searched through a lazily built DFA; each DFA state is
+ * the set of NFA states that can be active at once */
+typedef struct dfa_t {
+    ere_t *ere;
+    nstate_t *nfa;
+    size_t nnfa;
+    size_t nfa_size;
+    int start;
+
+    size_t nstates;
+    size_t cap;
+    unsigned long flushes;
+    int32_t initial;
+    int32_t *trans;
+    uint8_t *accept;
+    uint32_t *set_off;
+    uint32_t *set_len;
+    int *sets;
+    size_t sets_len;
+    size_t sets_size;
+    int32_t *buckets;
+    int32_t *chain;
+    size_t nbuckets;
+
+    /* scratch space for building state sets */
+    int *work;
+    int *stack;
+    uint32_t *mark;
+    uint32_t gen;
+} dfa_t;
+
+dfa_t *dfa_compile(const char *pattern, int icase);
+int dfa_exec(dfa_t *dfa, const char *str, size_t len);
+void dfa_free(dfa_t *dfa);
+
+#endif /* PACFIND_DFA_H */
@@ -0,0 +1,344 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "ere.h"
+
+/* repetition counts above this are left to the POSIX engine */
+#define ERE_MAX_REPEAT 32
+
+typedef struct ereparser_t {
+    ere_t *ere;
+    const char *p;
+    int icase;
+    int depth;
+} ereparser_t;
+
+int ere_regex(ereparser_t *ps);
+
+int ere_node(ere_t *ere, eretype_t type, int left, int right) {
+    erenode_t *n;
+
+    if(ere->count == ere->size) {
+        ere->size *= 2;
+        ere->nodes = realloc(ere->nodes, ere->size * sizeof(erenode_t));
+    }
+    n = ere->nodes + ere->count;
+    memset(n, 0, sizeof(erenode_t));
+    n->type = type;
+    n->left = left;
+    n->right = right;
+    return ere->count++;
+}
+
+void ere_set_add(uint64_t *set, unsigned char c) {
+    set[c >> 6] |= (uint64_t) 1 << (c & 63);
+}
+
+/* finishes a character set: case folding pairs letters up and REG_NEWLINE
+ * keeps negated sets (and '.') from matching a newline */
+int ere_set_node(ereparser_t *ps, uint64_t *set, int negate) {
+    int n = ere_node(ps->ere, ERE_SET, -1, -1);
+    uint64_t *dst = ps->ere->nodes[n].set;
+    int c, i;
+
+    if(ps->icase) {
+        for(c = 'a'; c <= 'z'; c++) {
+            if(ere_set_test(set, c) || ere_set_test(set, c - 32)) {
+                ere_set_add(set, c);
+                ere_set_add(set, c - 32);
+            }
+        }
+    }
+    for(i = 0; i < 4; i++) {
+        dst[i] = negate ? ~set[i] : set[i];
+    }
+    if(negate) {
+        dst['\n' >> 6] &= ~((uint64_t) 1 << ('\n' & 63));
+    }
+    return n;
+}
+
+int ere_class(const char *name, size_t len, uint64_t *set) {
+    static const struct {
+        const char *name;
+        int (*fn)(int);
+    } classes[] = {
+        {"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum},
+        {"space", isspace}, {"punct", ispunct}, {"xdigit", isxdigit},
+        {"blank", isblank}, {"cntrl", iscntrl}, {"print", isprint},
+        {"graph", isgraph}, {"upper", isupper}, {"lower", islower},
+        {NULL, NULL}
+    };
+    int i, c;
+
+    for(i = 0; classes[i].name; i++) {
+        if(strlen(classes[i].name) == len && strncmp(classes[i].name, name, len) == 0) {
+            for(c = 0; c < 256; c++) {
+                if(classes[i].fn(c)) {
+                    ere_set_add(set, c);
+                }
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int ere_bracket(ereparser_t *ps) {
+    uint64_t set[4] = { 0, 0, 0, 0 };
+    int negate = 0, first = 1;
+
+    if(*ps->p == '^') {
+        negate = 1;
+        ps->p++;
+    }
+
+    for(;;) {
+        unsigned char lo = *ps->p, hi;
+
+        if(lo == '\0') {
+            return -1;
+        }
+        if(lo == ']' && !first) {
+            ps->p++;
+            break;
+        }
+        first = 0;
+
+        if(lo == '[' && ps->p[1] == ':') {
+            const char *end = strstr(ps->p + 2, ":]");
+            if(end == NULL || ere_class(ps->p + 2, end - ps->p - 2, set) != 0) {
+                return -1;
+            }
+            ps->p = end + 2;
+            continue;
+        }
+        if(lo == '[' && (ps->p[1] == '.' || ps->p[1] == '=')) {
+            return -1;
+        }
+
+        ps->p++;
+        if(*ps->p == '-' && ps->p[1] != ']' && ps->p[1] != '\0') {
+            hi = ps->p[1];
+            if(hi == '[' || hi < lo) {
+                return -1;
+            }
+            ps->p += 2;
+        } else {
+            hi = lo;
+        }
+        while(1) {
+            ere_set_add(set, lo);
+            if(lo == hi) {
+                break;
+            }
+            lo++;
+        }
+    }
+
+    return ere_set_node(ps, set, negate);
+}
+
+int ere_atom(ereparser_t *ps) {
+    uint64_t set[4] = { 0, 0, 0, 0 };
+    unsigned char c = *ps->p;
+    int n;
+
+    switch(c) {
+        case '(':
+            ps->p++;
+            if(*ps->p == ')' || ++ps->depth > 64) {
+                return -1;
+            }
+            if((n = ere_regex(ps)) < 0 || *ps->p != ')') {
+                return -1;
+            }
+            ps->p++;
+            ps->depth--;
+            return n;
+        case '[':
+            ps->p++;
+            return ere_bracket(ps);
+        case '.':
+            ps->p++;
+            return ere_set_node(ps, set, 1);
+        case '^':
+            ps->p++;
+            return ere_node(ps->ere, ERE_BOL, -1, -1);
+        case '$':
+            ps->p++;
+            return ere_node(ps->ere, ERE_EOL, -1, -1);
+        case '\\':
+            c = ps->p[1];
+            if(c == '\0' || !strchr(".[]()*+?{}|\\^$", c)) {
+                return -1;
+            }
+            ps->p += 2;
+            break;
+        case '\0':
+        case ')':
+        case '|':
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+        case '}':
+            return -1;
+        default:
+            ps->p++;
+            break;
+    }
+
+    ere_set_add(set, c);
+    return ere_set_node(ps, set, 0);
+}
+
+int ere_number(ereparser_t *ps) {
+    int n = 0;
+
+    if(!isdigit((unsigned char) *ps->p)) {
+        return -1;
+    }
+    while(isdigit((unsigned char) *ps->p)) {
+        n = n * 10 + (*ps->p++ - '0');
+        if(n > ERE_MAX_REPEAT) {
+            return -1;
+        }
+    }
+    return n;
+}
+
+/* a{m,n} becomes m copies of a followed by n - m optional copies; the
+ * copies share one subtree */
+int ere_repeat(ereparser_t *ps, int atom) {
+    ere_t *ere = ps->ere;
+    int min, max, i, n = -1, tail = -1;
+
+    if((min = ere_number(ps)) < 0) {
+        return -1;
+    }
+    if(*ps->p == ',') {
+        ps->p++;
+        if(*ps->p == '}') {
+            max = -1;
+        } else if((max = ere_number(ps)) < min) {
+            return -1;
+        }
+    } else {
+        max = min;
+    }
+    if(*ps->p++ != '}') {
+        return -1;
+    }
+
+    if(max < 0) {
+        tail = ere_node(ere, ERE_STAR, atom, -1);
+    } else {
+        for(i = min; i < max; i++) {
+            int opt = tail < 0 ? atom : ere_node(ere, ERE_CAT, atom, tail);
+            tail = ere_node(ere, ERE_QUEST, opt, -1);
+        }
+    }
+    for(i = 0; i < min; i++) {
+        n = n < 0 ? atom : ere_node(ere, ERE_CAT, n, atom);
+    }
+
+    if(n < 0 && tail < 0) {
+        return ere_node(ere, ERE_EMPTY, -1, -1);
+    }
+    if(n < 0) {
+        return tail;
+    }
+    return tail < 0 ? n : ere_node(ere, ERE_CAT, n, tail);
+}
+
+int ere_piece(ereparser_t *ps) {
+    int n = ere_atom(ps);
+    eretype_t atomtype;
+
+    if(n < 0) {
+        return -1;
+    }
+    atomtype = ps->ere->nodes[n].type;
+
+    while(*ps->p && strchr("*+?{", *ps->p)) {
+        if(atomtype == ERE_BOL || atomtype == ERE_EOL) {
+            return -1;
+        }
+        switch(*ps->p++) {
+            case '*':
+                n = ere_node(ps->ere, ERE_STAR, n, -1);
+                break;
+            case '+':
+                n = ere_node(ps->ere, ERE_PLUS, n, -1);
+                break;
+            case '?':
+                n = ere_node(ps->ere, ERE_QUEST, n, -1);
+                break;
+            case '{':
+                if((n = ere_repeat(ps, n)) < 0) {
+                    return -1;
+                }
+                break;
+        }
+    }
+    return n;
+}
+
+int ere_branch(ereparser_t *ps) {
+    int n = -1;
+
+    while(*ps->p && *ps->p != '|' && *ps->p != ')') {
+        int piece = ere_piece(ps);
+        if(piece < 0) {
+            return -1;
+        }
+        n = n < 0 ? piece : ere_node(ps->ere, ERE_CAT, n, piece);
+    }
+    return n;
+}
+
+int ere_regex(ereparser_t *ps) {
+    int n = ere_branch(ps);
+
+    while(n >= 0 && *ps->p == '|') {
+        int branch;
+        ps->p++;
+        if((branch = ere_branch(ps)) < 0) {
+            return -1;
+        }
+        n = ere_node(ps->ere, ERE_ALT, n, branch);
+    }
+    return n;
+}
+
+/* returns NULL for anything outside the subset whose meaning is certain;
+ * those patterns are left to the POSIX engine */
+ere_t *ere_parse(const char *pattern, int icase) {
+    ereparser_t ps;
+    ere_t *ere = calloc(1, sizeof(ere_t));
+
+    ere->size = 16;
+    ere->nodes = malloc(ere->size * sizeof(erenode_t));
+
+    ps.ere = ere;
+    ps.p = pattern;
+    ps.icase = icase;
+    ps.depth = 0;
+
+    ere->root = ere_regex(&ps);
+    if(ere->root < 0 || *ps.p != '\0') {
+        ere_free(ere);
+        return NULL;
+    }
+    return ere;
+}
+
+void ere_free(ere_t *ere) {
+    if(ere == NULL) {
+        return;
+    }
+    free(ere->nodes);
+    free(ere);
+}
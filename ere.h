@@ -0,0 +1,42 @@
+#ifndef PACFIND_ERE_H
+#define PACFIND_ERE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum eretype_t {
+    ERE_SET,
+    ERE_CAT,
+    ERE_ALT,
+    ERE_STAR,
+    ERE_PLUS,
+    ERE_QUEST,
+    ERE_BOL,
+    ERE_EOL,
+    ERE_EMPTY
+} eretype_t;
+
+/* a parsed extended regex; character sets already account for REG_ICASE
+ * and REG_NEWLINE, so matching only ever compares raw bytes */
+typedef struct erenode_t {
+    eretype_t type;
+    int left;
+    int right;
+    uint64_t set[4];
+} erenode_t;
+
+typedef struct ere_t {
+    erenode_t *nodes;
+    size_t count;
+    size_t size;
+    int root;
+} ere_t;
+
+ere_t *ere_parse(const char *pattern, int icase);
+void ere_free(ere_t *ere);
+
+static inline int ere_set_test(const uint64_t *set, unsigned char c) {
+    return (set[c >> 6] >> (c & 63)) & 1;
+}
+
+#endif /* PACFIND_ERE_H */
@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "out.h"
+#include "format.h"
+
+typedef struct fmtfield_t {
+    const char *name;
+    fmtkind_t kind;
+    int col;
+    const char *label;
+} fmtfield_t;
+
+/* the fields a template can name, in the order --json and -i print them;
+ * entries without a label are aliases */
+const fmtfield_t format_fields[] = {
+    {"repo"        , FMT_REPO   , 0                , "Repository"},
+    {"name"        , FMT_STR    , SCOL_NAME        , "Name"},
+    {"version"     , FMT_STR    , SCOL_VERSION     , "Version"},
+    {"desc"        , FMT_STR    , SCOL_DESC        , "Description"},
+    {"arch"        , FMT_STR    , SCOL_ARCH        , "Architecture"},
+    {"url"         , FMT_STR    , SCOL_URL         , "URL"},
+    {"license"     , FMT_LIST   , LCOL_LICENSE     , "Licenses"},
+    {"groups"      , FMT_LIST   , LCOL_GROUP       , "Groups"},
+    {"provides"    , FMT_LIST   , LCOL_PROVIDES    , "Provides"},
+    {"depends"     , FMT_LIST   , LCOL_DEPENDS     , "Depends On"},
+    {"optdepends"  , FMT_LIST   , LCOL_OPTDEPENDS  , "Optional Deps"},
+    {"conflicts"   , FMT_LIST   , LCOL_CONFLICTS   , "Conflicts With"},
+    {"replaces"    , FMT_LIST   , LCOL_REPLACES    , "Replaces"},
+    {"size"        , FMT_NUM    , NCOL_SIZE        , "Download Size"},
+    {"isize"       , FMT_NUM    , NCOL_ISIZE       , "Installed Size"},
+    {"packager"    , FMT_STR    , SCOL_PACKAGER    , "Packager"},
+    {"builddate"   , FMT_NUM    , NCOL_BUILDDATE   , "Build Date"},
+    {"installdate" , FMT_NUM    , NCOL_INSTALLDATE , "Install Date"},
+    {"reason"      , FMT_REASON , NCOL_REASON      , "Install Reason"},
+    {"filename"    , FMT_STR    , SCOL_FILENAME    , "Filename"},
+    {"md5sum"      , FMT_STR    , SCOL_MD5SUM      , "MD5 Sum"},
+    {"sha256sum"   , FMT_STR    , SCOL_SHA256SUM   , "SHA-256 Sum"},
+
+    {"db"          , FMT_REPO   , 0                , NULL},
+    {"group"       , FMT_LIST   , LCOL_GROUP       , NULL},
+    {NULL, 0, 0, NULL}
+};
+
+const fmtfield_t *format_field(const char *name, size_t len) {
+    const fmtfield_t *f;
+    for(f = format_fields; f->name; f++) {
+        if(strncmp(name, f->name, len) == 0 && f->name[len] == '\0') {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+format_t *format_new(size_t bufsize) {
+    format_t *fmt = calloc(1, sizeof(format_t));
+    fmt->buf = malloc(bufsize);
+    fmt->none = "";
+    fmt->join = " ";
+    return fmt;
+}
+
+void format_add(format_t *fmt, fmtkind_t kind, int col, const char *text, size_t len) {
+    fmtop_t *op;
+
+    /* adjacent text is merged into a single write */
+    if(kind == FMT_TEXT && fmt->len && fmt->ops[fmt->len - 1].kind == FMT_TEXT
+            && fmt->ops[fmt->len - 1].text + fmt->ops[fmt->len - 1].len == text) {
+        fmt->ops[fmt->len - 1].len += len;
+        return;
+    }
+    if(fmt->len == fmt->size) {
+        fmt->size = fmt->size ? fmt->size * 2 : 16;
+        fmt->ops = realloc(fmt->ops, fmt->size * sizeof(fmtop_t));
+    }
+    op = fmt->ops + fmt->len++;
+    op->kind = kind;
+    op->col = col;
+    op->text = text;
+    op->len = len;
+}
+
+/* literal text is unescaped into fmt->buf, which is never longer than the
+ * template itself plus the NUL terminator */
+format_t *format_compile(const char *spec, int nul, const char **err) {
+    format_t *fmt = format_new(strlen(spec) + 2);
+    char *t = fmt->buf;
+    const char *p = spec;
+
+    while(*p) {
+        const fmtfield_t *f;
+        const char *name, *end;
+
+        if(*p == '\\' && p[1]) {
+            switch(p[1]) {
+                case 'n': *t = '\n'; break;
+                case 't': *t = '\t'; break;
+                case '0': *t = '\0'; break;
+                case '\\': *t = '\\'; break;
+                default:
+                    *err = "unknown escape in format";
+                    format_free(fmt);
+                    return NULL;
+            }
+            format_add(fmt, FMT_TEXT, 0, t++, 1);
+            p += 2;
+            continue;
+        }
+        if(*p != '%') {
+            format_add(fmt, FMT_TEXT, 0, t, 1);
+            *t++ = *p++;
+            continue;
+        }
+
+        p++;
+        switch(*p) {
+            case '%':
+                format_add(fmt, FMT_TEXT, 0, t, 1);
+                *t++ = '%';
+                p++;
+                continue;
+            case 'n': name = "name"; end = name + 4; break;
+            case 'v': name = "version"; end = name + 7; break;
+            case 'd': name = "desc"; end = name + 4; break;
+            case 'r': name = "repo"; end = name + 4; break;
+            case 'a': name = "arch"; end = name + 4; break;
+            case 's':
+                if(p[1] != '{') {
+                    *err = "unknown directive in format";
+                    format_free(fmt);
+                    return NULL;
+                }
+                p++;
+                /* fall through */
+            case '{':
+                name = p + 1;
+                if((end = strchr(name, '}')) == NULL) {
+                    *err = "unterminated field in format";
+                    format_free(fmt);
+                    return NULL;
+                }
+                p = end;
+                break;
+            default:
+                *err = "unknown directive in format";
+                format_free(fmt);
+                return NULL;
+        }
+        p++;
+
+        if((f = format_field(name, end - name)) == NULL) {
+            *err = "unknown field in format";
+            format_free(fmt);
+            return NULL;
+        }
+        format_add(fmt, f->kind, f->col, NULL, 0);
+    }
+
+    if(nul) {
+        *t = '\0';
+        format_add(fmt, FMT_TEXT, 0, t++, 1);
+    }
+
+    return fmt;
+}
+
+/* one object per line in a single array */
+format_t *format_json(void) {
+    format_t *fmt = format_new(1024);
+    const fmtfield_t *f;
+    char *t = fmt->buf;
+    int n;
+
+    for(f = format_fields; f->label; f++) {
+        n = sprintf(t, "%s\"%s\":", f == format_fields ? "\n{" : ",", f->name);
+        format_add(fmt, FMT_TEXT, 0, t, n);
+        t += n + 1;
+        format_add(fmt, f->kind, f->col, NULL, 0);
+    }
+    format_add(fmt, FMT_TEXT, 0, "}", 1);
+
+    fmt->head = "[";
+    fmt->sep = ",";
+    fmt->tail = "\n]\n";
+    fmt->json = 1;
+    return fmt;
+}
+
+/* pacman -Qi style */
+format_t *format_info(void) {
+    format_t *fmt = format_new(1024);
+    const fmtfield_t *f;
+    char *t = fmt->buf;
+    int n;
+
+    for(f = format_fields; f->label; f++) {
+        n = sprintf(t, "%-15s : ", f->label);
+        format_add(fmt, FMT_TEXT, 0, t, n);
+        t += n + 1;
+        format_add(fmt, f->kind, f->col, NULL, 0);
+        format_add(fmt, FMT_TEXT, 0, "\n", 1);
+    }
+
+    fmt->sep = "\n";
+    fmt->none = "None";
+    fmt->join = "  ";
+    fmt->human = 1;
+    return fmt;
+}
+
+void format_free(format_t *fmt) {
+    if(fmt == NULL) {
+        return;
+    }
+    free(fmt->ops);
+    free(fmt->buf);
+    free(fmt);
+}
+
+void format_begin(format_t *fmt) {
+    fmt->count = 0;
+    out_str(fmt->head);
+}
+
+void format_end(format_t *fmt) {
+    out_str(fmt->tail);
+}
+
+void format_json_escape(const char *str, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const char *run = str;
+    size_t i;
+
+    for(i = 0; i < len; i++) {
+        unsigned char c = str[i];
+
+        if(c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out_write(run, str + i - run);
+        run = str + i + 1;
+        switch(c) {
+            case '"': out_write("\\\"", 2); break;
+            case '\\': out_write("\\\\", 2); break;
+            case '\n': out_write("\\n", 2); break;
+            case '\t': out_write("\\t", 2); break;
+            default:
+                {
+                    char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+                    out_write(esc, 6);
+                }
+                break;
+        }
+    }
+    out_write(run, str + len - run);
+}
+
+void format_text(format_t *fmt, const char *str, size_t len) {
+    if(fmt->json) {
+        format_json_escape(str, len);
+    } else {
+        out_write(str, len);
+    }
+}
+
+void format_str(format_t *fmt, const char *str, size_t len) {
+    if(str == NULL) {
+        out_str(fmt->json ? "null" : fmt->none);
+    } else if(fmt->json) {
+        out_char('"');
+        format_json_escape(str, len);
+        out_char('"');
+    } else {
+        out_write(str, len);
+    }
+}
+
+void format_int(int64_t value) {
+    char buf[24], *p = buf + sizeof(buf);
+    uint64_t v = value < 0 ? -(uint64_t) value : (uint64_t) value;
+
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while(v);
+    if(value < 0) {
+        *--p = '-';
+    }
+    out_write(p, buf + sizeof(buf) - p);
+}
+
+void format_human(numcol_t col, int64_t value) {
+    static const char *units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    char buf[128];
+    size_t len;
+
+    if(col == NCOL_SIZE || col == NCOL_ISIZE) {
+        double size = value;
+        int u = 0;
+        while((size >= 1024 || size <= -1024) && u < 4) {
+            size /= 1024;
+            u++;
+        }
+        len = snprintf(buf, sizeof(buf), "%.2f %s", size, units[u]);
+    } else {
+        time_t t = value;
+        struct tm tm;
+        len = strftime(buf, sizeof(buf), "%c", localtime_r(&t, &tm));
+    }
+    out_write(buf, len);
+}
+
+const char *format_depmod(alpm_depmod_t mod) {
+    switch(mod) {
+        case ALPM_DEP_MOD_EQ: return "=";
+        case ALPM_DEP_MOD_GE: return ">=";
+        case ALPM_DEP_MOD_LE: return "<=";
+        case ALPM_DEP_MOD_GT: return ">";
+        case ALPM_DEP_MOD_LT: return "<";
+        default: return "";
+    }
+}
+
+void format_list(format_t *fmt, const snapshot_t *snap, listcol_t col, size_t id) {
+    size_t i, n;
+    const snapitem_t *items = snap_list(snap, col, id, &n);
+
+    if(fmt->json) {
+        out_char('[');
+    } else if(n == 0) {
+        out_str(fmt->none);
+    }
+    for(i = 0; i < n; i++) {
+        const char *name = snap_item_str(snap, id, items[i].str);
+        const char *version = snap_item_str(snap, id, items[i].version);
+
+        if(i) {
+            out_str(fmt->json ? "," : fmt->join);
+        }
+        if(fmt->json) {
+            out_char('"');
+        }
+        format_text(fmt, name, items[i].len);
+        /* dependencies are printed the way pacman writes them */
+        if(version && *version) {
+            out_str(format_depmod(items[i].mod));
+            format_text(fmt, version, strlen(version));
+        }
+        if(fmt->json) {
+            out_char('"');
+        }
+    }
+    if(fmt->json) {
+        out_char(']');
+    }
+}
+
+void format_pkg(format_t *fmt, const snapshot_t *snap, size_t id) {
+    size_t i;
+
+    if(fmt->count++) {
+        out_str(fmt->sep);
+    }
+
+    for(i = 0; i < fmt->len; i++) {
+        const fmtop_t *op = fmt->ops + i;
+        int64_t value;
+
+        switch(op->kind) {
+            case FMT_TEXT:
+                out_write(op->text, op->len);
+                break;
+            case FMT_STR:
+                format_str(fmt, snap_str(snap, op->col, id), snap_strlen(snap, op->col, id));
+                break;
+            case FMT_LIST:
+                format_list(fmt, snap, op->col, id);
+                break;
+            case FMT_NUM:
+                value = snap_num(snap, op->col, id);
+                /* packages that are not installed have no install date */
+                if(op->col == NCOL_INSTALLDATE && value == 0) {
+                    format_str(fmt, NULL, 0);
+                } else if(fmt->human) {
+                    format_human(op->col, value);
+                } else {
+                    format_int(value);
+                }
+                break;
+            case FMT_REPO:
+                format_str(fmt, snap_dbname(snap, id), strlen(snap_dbname(snap, id)));
+                break;
+            case FMT_REASON:
+                if(!snap_local(snap, id)) {
+                    format_str(fmt, NULL, 0);
+                } else if(snap_num(snap, op->col, id) == ALPM_PKG_REASON_DEPEND) {
+                    format_str(fmt, "dependency", 10);
+                } else {
+                    format_str(fmt, "explicit", 8);
+                }
+                break;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef PACFIND_FORMAT_H
+#define PACFIND_FORMAT_H
+
+#include <stddef.h>
+
+#include "snapshot.h"
+
+typedef enum fmtkind_t {
+    FMT_TEXT,
+    FMT_STR,
+    FMT_LIST,
+    FMT_NUM,
+    FMT_REPO,
+    FMT_REASON
+} fmtkind_t;
+
+/* one step of a compiled format: literal text or a package field */
+typedef struct fmtop_t {
+    fmtkind_t kind;
+    int col;
+    const char *text;
+    size_t len;
+} fmtop_t;
+
+/* an output template compiled once and run for every package; head and
+ * tail wrap the whole output and sep goes between packages.  Missing values
+ * print as none, list entries are separated by join, and json quotes and
+ * escapes values (none and join are then ignored).  human prints sizes and
+ * dates for reading rather than as plain integers */
+typedef struct format_t {
+    fmtop_t *ops;
+    size_t len;
+    size_t size;
+    char *buf;
+
+    const char *head;
+    const char *sep;
+    const char *tail;
+    const char *none;
+    const char *join;
+    int json;
+    int human;
+
+    size_t count;
+} format_t;
+
+/* compiles a --format template; nul terminates every package with a NUL
+ * byte.  Returns NULL and sets *err if the template is invalid */
+format_t *format_compile(const char *spec, int nul, const char **err);
+format_t *format_json(void);
+format_t *format_info(void);
+void format_free(format_t *fmt);
+
+void format_begin(format_t *fmt);
+void format_pkg(format_t *fmt, const snapshot_t *snap, size_t id);
+void format_end(format_t *fmt);
+
+/* writes str escaped for use inside a JSON string */
+void format_json_escape(const char *str, size_t len);
+
+#endif /* PACFIND_FORMAT_H */
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "literal.h"
+
+/* regexes are matched with REG_ICASE in the C locale, which only folds
+ * ASCII letters */
+static inline unsigned char lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+}
+
+literal_t *literal_compile(const char *pattern) {
+    size_t len = strlen(pattern);
+    litanchor_t anchor = LIT_ANY;
+    literal_t *lit;
+    size_t i;
+
+    if(len && pattern[0] == '^') {
+        anchor |= LIT_START;
+        pattern++;
+        len--;
+    }
+    if(len && pattern[len - 1] == '$') {
+        anchor |= LIT_END;
+        len--;
+    }
+    if(len == 0) {
+        return NULL;
+    }
+    for(i = 0; i < len; i++) {
+        if(strchr(".[]()*+?{}|\\^$\n", pattern[i])) {
+            return NULL;
+        }
+    }
+
+    lit = malloc(sizeof(literal_t));
+    lit->needle = malloc(len + 1);
+    for(i = 0; i < len; i++) {
+        lit->needle[i] = lower(pattern[i]);
+    }
+    lit->needle[len] = '\0';
+    lit->len = len;
+    lit->anchor = anchor;
+    return lit;
+}
+
+void literal_free(literal_t *lit) {
+    if(lit == NULL) {
+        return;
+    }
+    free(lit->needle);
+    free(lit);
+}
+
+int literal_eq(const char *str, const char *needle, size_t len) {
+    size_t i;
+    for(i = 0; i < len; i++) {
+        if(lower(str[i]) != (unsigned char) needle[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#ifdef __SSE2__
+static inline __m128i lower16(__m128i v) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+            _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/* compare the first and last needle bytes against 16 candidate positions at
+ * once and only verify the positions where both match */
+int literal_find(const literal_t *lit, const char *str, size_t len) {
+    size_t n = lit->len, i = 0;
+
+    if(n > len) {
+        return 0;
+    }
+
+#ifdef __SSE2__
+    {
+        const __m128i first = _mm_set1_epi8(lit->needle[0]);
+        const __m128i last = _mm_set1_epi8(lit->needle[n - 1]);
+
+        for(; i + n - 1 + 16 <= len; i += 16) {
+            __m128i bf = lower16(_mm_loadu_si128((const __m128i*) (str + i)));
+            __m128i bl = lower16(_mm_loadu_si128((const __m128i*) (str + i + n - 1)));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+                        _mm_cmpeq_epi8(bf, first), _mm_cmpeq_epi8(bl, last)));
+
+            while(mask) {
+                size_t pos = i + __builtin_ctz(mask);
+                if(n <= 2 || literal_eq(str + pos + 1, lit->needle + 1, n - 2)) {
+                    return 1;
+                }
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+
+    for(; i + n <= len; i++) {
+        if(lower(str[i]) == (unsigned char) lit->needle[0]
+                && literal_eq(str + i, lit->needle, n)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ^ and $ also match around newlines (REG_NEWLINE), so anchored literals
+ * are tested against every line */
+int literal_match(const literal_t *lit, const char *str, size_t len) {
+    const char *line = str, *end = str + len;
+
+    if(lit->anchor == LIT_ANY) {
+        return literal_find(lit, str, len);
+    }
+
+    while(line <= end) {
+        const char *eol = memchr(line, '\n', end - line);
+        size_t linelen;
+
+        if(eol == NULL) {
+            eol = end;
+        }
+        linelen = eol - line;
+
+        if(linelen >= lit->len) {
+            switch(lit->anchor) {
+                case LIT_START:
+                    if(literal_eq(line, lit->needle, lit->len)) {
+                        return 1;
+                    }
+                    break;
+                case LIT_END:
+                    if(literal_eq(eol - lit->len, lit->needle, lit->len)) {
+                        return 1;
+                    }
+                    break;
+                default:
+                    if(linelen == lit->len && literal_eq(line, lit->needle, lit->len)) {
+                        return 1;
+                    }
+                    break;
+            }
+        }
+
+        line = eol + 1;
+    }
+    return 0;
+}
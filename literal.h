@@ -0,0 +1,25 @@
+#ifndef PACFIND_LITERAL_H
+#define PACFIND_LITERAL_H
+
+#include <stddef.h>
+
+typedef enum litanchor_t {
+    LIT_ANY = 0,
+    LIT_START = 1,
+    LIT_END = 2,
+    LIT_LINE = LIT_START | LIT_END
+} litanchor_t;
+
+/* a regex without metacharacters, optionally anchored with ^ and/or $,
+ * matched case-insensitively without going through regexec */
+typedef struct literal_t {
+    char *needle;
+    size_t len;
+    litanchor_t anchor;
+} literal_t;
+
+literal_t *literal_compile(const char *pattern);
+int literal_match(const literal_t *lit, const char *str, size_t len);
+void literal_free(literal_t *lit);
+
+#endif /* PACFIND_LITERAL_H */
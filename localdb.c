@@ -0,0 +1,161 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "desc.h"
+#include "localdb.h"
+
+/* the desc sections libalpm reads from the local database; the installed
+ * size has been written as %SIZE% since long ago */
+const descfield_t localdb_fields[] = {
+    { "%NAME%", DESC_STR, SCOL_NAME },
+    { "%DESC%", DESC_STR, SCOL_DESC },
+    { "%VERSION%", DESC_STR, SCOL_VERSION },
+    { "%URL%", DESC_STR, SCOL_URL },
+    { "%PACKAGER%", DESC_STR, SCOL_PACKAGER },
+    { "%ARCH%", DESC_STR, SCOL_ARCH },
+    { "%SIZE%", DESC_NUM, NCOL_ISIZE },
+    { "%ISIZE%", DESC_NUM, NCOL_ISIZE },
+    { "%BUILDDATE%", DESC_NUM, NCOL_BUILDDATE },
+    { "%INSTALLDATE%", DESC_NUM, NCOL_INSTALLDATE },
+    { "%REASON%", DESC_NUM, NCOL_REASON },
+    { "%LICENSE%", DESC_LIST, LCOL_LICENSE },
+    { "%GROUPS%", DESC_LIST, LCOL_GROUP },
+    { "%OPTDEPENDS%", DESC_LIST, LCOL_OPTDEPENDS },
+    { "%DEPENDS%", DESC_DEPENDS, LCOL_DEPENDS },
+    { "%CONFLICTS%", DESC_DEPENDS, LCOL_CONFLICTS },
+    { "%PROVIDES%", DESC_DEPENDS, LCOL_PROVIDES },
+    { "%REPLACES%", DESC_DEPENDS, LCOL_REPLACES },
+    { NULL, 0, 0 }
+};
+
+/* the package directories, split between tasks */
+typedef struct localread_t {
+    const char *path;
+    char **dirs;
+    descpkg_t *pkgs;
+    size_t count;
+    size_t chunk;
+} localread_t;
+
+/* appends a file and a blank line to the package's text; the buffer is
+ * sized from fstat so the file is read in one go */
+int localdb_append(descpkg_t *pkg, const char *path) {
+    struct stat st;
+    size_t size;
+    ssize_t n;
+    int fd;
+
+    if((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        return -1;
+    }
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    size = pkg->len + st.st_size + 3;
+    pkg->text = realloc(pkg->text, size);
+    while((n = read(fd, pkg->text + pkg->len, size - pkg->len - 2)) > 0) {
+        pkg->len += n;
+        if(size - pkg->len < 3) {
+            size *= 2;
+            pkg->text = realloc(pkg->text, size);
+        }
+    }
+    close(fd);
+    if(n < 0) {
+        return -1;
+    }
+
+    pkg->text[pkg->len++] = '\n';
+    pkg->text[pkg->len++] = '\n';
+    return 0;
+}
+
+/* a package that cannot be read is left without text */
+void localread_task(localread_t *lr, size_t task, size_t worker) {
+    size_t i = task * lr->chunk, last = i + lr->chunk;
+    char file[4096];
+    (void) worker;
+
+    for(; i < last && i < lr->count; i++) {
+        descpkg_t *pkg = lr->pkgs + i;
+
+        snprintf(file, sizeof(file), "%s/%s/desc", lr->path, lr->dirs[i]);
+        if(localdb_append(pkg, file) == 0) {
+            /* databases written before pacman 4.2 keep dependencies apart */
+            snprintf(file, sizeof(file), "%s/%s/depends", lr->path, lr->dirs[i]);
+            if(localdb_append(pkg, file) == 0 || errno == ENOENT) {
+                continue;
+            }
+        }
+        free(pkg->text);
+        pkg->text = NULL;
+    }
+}
+
+dbsnap_t *localdb_read(const char *path, pool_t *pool) {
+    localread_t lr = { path, NULL, NULL, 0, 0 };
+    size_t size = 0, ntasks = 1, i;
+    struct dirent *ent;
+    dbsnap_t *db = NULL;
+    DIR *dir;
+
+    if((dir = opendir(path)) == NULL) {
+        return NULL;
+    }
+    while((ent = readdir(dir))) {
+        struct stat st;
+
+        if(ent->d_name[0] == '.') {
+            continue;
+        }
+        /* ALPM_DB_VERSION sits beside the package directories */
+        if(ent->d_type != DT_DIR && (ent->d_type != DT_UNKNOWN
+                    || fstatat(dirfd(dir), ent->d_name, &st, 0) != 0 || !S_ISDIR(st.st_mode))) {
+            continue;
+        }
+        if(lr.count == size) {
+            size = size ? size * 2 : 1024;
+            lr.dirs = realloc(lr.dirs, size * sizeof(char*));
+        }
+        lr.dirs[lr.count++] = strdup(ent->d_name);
+    }
+    closedir(dir);
+
+    /* on a cold page cache the reads are mostly waiting, so there are
+     * several tasks per thread to keep every thread busy */
+    lr.pkgs = calloc(lr.count ? lr.count : 1, sizeof(descpkg_t));
+    if(pool && pool->nthreads > 1 && lr.count > 1) {
+        ntasks = pool->nthreads * 4 < lr.count ? pool->nthreads * 4 : lr.count;
+    }
+    lr.chunk = (lr.count + ntasks - 1) / ntasks;
+    if(ntasks > 1) {
+        pool_run(pool, ntasks, (task_fn) localread_task, &lr);
+    } else {
+        localread_task(&lr, 0, 0);
+    }
+
+    for(i = 0; i < lr.count; i++) {
+        if(lr.pkgs[i].text == NULL) {
+            break;
+        }
+    }
+    if(i == lr.count) {
+        db = desc_build("local", 1, localdb_fields, lr.pkgs, lr.count);
+    }
+
+    for(i = 0; i < lr.count; i++) {
+        free(lr.pkgs[i].text);
+        free(lr.dirs[i]);
+    }
+    free(lr.pkgs);
+    free(lr.dirs);
+    return db;
+}
@@ -0,0 +1,13 @@
+#ifndef PACFIND_LOCALDB_H
+#define PACFIND_LOCALDB_H
+
+#include "pool.h"
+#include "snapshot.h"
+
+/* reads the local database directory at path straight into a dbsnap_t,
+ * without going through libalpm's package objects; the desc files are read
+ * on the pool's threads if there is a pool.  Returns NULL if the directory
+ * or any package in it cannot be read */
+dbsnap_t *localdb_read(const char *path, pool_t *pool);
+
+#endif /* PACFIND_LOCALDB_H */
@@ -0,0 +1,129 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nameset.h"
+
+uint64_t nameset_hash(const char *name, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    while(len--) {
+        h ^= (unsigned char) *name++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+nameset_t *nameset_new(void) {
+    nameset_t *set = calloc(1, sizeof(nameset_t));
+    set->mask = 15;
+    set->slots = calloc(set->mask + 1, sizeof(uint32_t));
+    return set;
+}
+
+/* slots hold an index into ents plus one; names that appear more than once
+ * (with different repos) occupy a slot each */
+void nameset_insert(nameset_t *set, size_t e) {
+    size_t h;
+    for(h = set->ents[e].hash & set->mask; set->slots[h]; h = (h + 1) & set->mask);
+    set->slots[h] = e + 1;
+}
+
+void nameset_add(nameset_t *set, const char *str, size_t len) {
+    nameent_t *ent;
+    char *copy, *slash;
+    size_t e;
+
+    if(set->count == set->size) {
+        set->size = set->size ? set->size * 2 : 64;
+        set->strs = realloc(set->strs, set->size * sizeof(char*));
+        set->ents = realloc(set->ents, set->size * sizeof(nameent_t));
+    }
+    if(2 * (set->count + 1) > set->mask + 1) {
+        free(set->slots);
+        set->mask = 2 * set->mask + 1;
+        set->slots = calloc(set->mask + 1, sizeof(uint32_t));
+        for(e = 0; e < set->count; e++) {
+            nameset_insert(set, e);
+        }
+    }
+
+    copy = malloc(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    ent = set->ents + set->count;
+    if((slash = memchr(copy, '/', len))) {
+        ent->repo = copy;
+        ent->repolen = slash - copy;
+        ent->name = slash + 1;
+    } else {
+        ent->repo = NULL;
+        ent->repolen = 0;
+        ent->name = copy;
+    }
+    ent->namelen = copy + len - ent->name;
+    ent->hash = nameset_hash(ent->name, ent->namelen);
+
+    set->strs[set->count] = copy;
+    nameset_insert(set, set->count++);
+}
+
+int nameset_has(const nameset_t *set, const char *dbname, const char *name, size_t len) {
+    uint64_t hash = nameset_hash(name, len);
+    size_t h;
+
+    for(h = hash & set->mask; set->slots[h]; h = (h + 1) & set->mask) {
+        const nameent_t *ent = set->ents + set->slots[h] - 1;
+        if(ent->hash != hash || ent->namelen != len || memcmp(ent->name, name, len) != 0) {
+            continue;
+        }
+        if(ent->repo == NULL || (strncmp(ent->repo, dbname, ent->repolen) == 0
+                    && dbname[ent->repolen] == '\0')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void nameset_free(nameset_t *set) {
+    size_t i;
+
+    if(set == NULL) {
+        return;
+    }
+    for(i = 0; i < set->count; i++) {
+        free(set->strs[i]);
+    }
+    free(set->strs);
+    free(set->ents);
+    free(set->slots);
+    free(set);
+}
+
+nameset_t *nameset_read(FILE *fp) {
+    nameset_t *set = NULL;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+
+    while((len = getline(&line, &size, fp)) != -1) {
+        char *start = line, *end = line + len;
+
+        while(start < end && isspace((unsigned char) *start)) {
+            start++;
+        }
+        while(end > start && isspace((unsigned char) end[-1])) {
+            end--;
+        }
+        if(end == start) {
+            continue;
+        }
+        if(set == NULL) {
+            set = nameset_new();
+        }
+        nameset_add(set, start, end - start);
+    }
+
+    free(line);
+    return set;
+}
@@ -0,0 +1,39 @@
+#ifndef PACFIND_NAMESET_H
+#define PACFIND_NAMESET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* a requested package, "name" or "repo/name" */
+typedef struct nameent_t {
+    const char *repo;
+    size_t repolen;
+    const char *name;
+    size_t namelen;
+    uint64_t hash;
+} nameent_t;
+
+/* the package names given on standard input, hashed by name so selecting
+ * the packages they refer to takes one lookup per package; the strings are
+ * kept in the order given */
+typedef struct nameset_t {
+    char **strs;
+    nameent_t *ents;
+    size_t count;
+    size_t size;
+
+    uint32_t *slots;
+    size_t mask;
+} nameset_t;
+
+nameset_t *nameset_new(void);
+void nameset_add(nameset_t *set, const char *str, size_t len);
+int nameset_has(const nameset_t *set, const char *dbname, const char *name, size_t len);
+void nameset_free(nameset_t *set);
+
+/* reads one name per line, ignoring surrounding whitespace and blank
+ * lines; returns NULL if there are none */
+nameset_t *nameset_read(FILE *fp);
+
+#endif /* PACFIND_NAMESET_H */
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+
+#include "numindex.h"
+
+typedef struct numentry_t {
+    int64_t value;
+    uint32_t id;
+} numentry_t;
+
+int numentry_cmp(const void *a, const void *b) {
+    const numentry_t *ea = a, *eb = b;
+    if(ea->value != eb->value) {
+        return ea->value < eb->value ? -1 : 1;
+    }
+    return ea->id < eb->id ? -1 : ea->id > eb->id;
+}
+
+numindex_t *numindex_new(const snapshot_t *snap, numcol_t col) {
+    numindex_t *idx = calloc(1, sizeof(numindex_t));
+    numentry_t *entries = malloc(snap->count * sizeof(numentry_t));
+    size_t i;
+
+    for(i = 0; i < snap->count; i++) {
+        entries[i].value = snap_num(snap, col, i);
+        entries[i].id = i;
+    }
+    qsort(entries, snap->count, sizeof(numentry_t), numentry_cmp);
+
+    idx->count = snap->count;
+    idx->ids = malloc(idx->count * sizeof(uint32_t));
+    idx->values = malloc(idx->count * sizeof(int64_t));
+    for(i = 0; i < idx->count; i++) {
+        idx->ids[i] = entries[i].id;
+        idx->values[i] = entries[i].value;
+    }
+
+    free(entries);
+    return idx;
+}
+
+/* the first entry not less than value */
+size_t numindex_lower(const numindex_t *idx, int64_t value) {
+    size_t lo = 0, hi = idx->count;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(idx->values[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* the first entry greater than value */
+size_t numindex_upper(const numindex_t *idx, int64_t value) {
+    size_t lo = 0, hi = idx->count;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(idx->values[mid] <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void numindex_free(numindex_t *idx) {
+    if(idx == NULL) {
+        return;
+    }
+    free(idx->ids);
+    free(idx->values);
+    free(idx);
+}
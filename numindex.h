@@ -0,0 +1,22 @@
+#ifndef PACFIND_NUMINDEX_H
+#define PACFIND_NUMINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "snapshot.h"
+
+/* package ids ordered by the value of one numeric column, so the packages
+ * a comparison with a constant selects form contiguous runs of the index */
+typedef struct numindex_t {
+    size_t count;
+    uint32_t *ids;
+    int64_t *values;
+} numindex_t;
+
+numindex_t *numindex_new(const snapshot_t *snap, numcol_t col);
+size_t numindex_lower(const numindex_t *idx, int64_t value);
+size_t numindex_upper(const numindex_t *idx, int64_t value);
+void numindex_free(numindex_t *idx);
+
+#endif /* PACFIND_NUMINDEX_H */
@@ -0,0 +1,58 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "out.h"
+
+char out_buf[OUT_BUFSIZE];
+size_t out_len = 0;
+int out_failed = 0;
+
+void out_raw(const char *str, size_t len) {
+    while(len && !out_failed) {
+        ssize_t n = write(STDOUT_FILENO, str, len);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            out_failed = 1;
+            break;
+        }
+        str += n;
+        len -= n;
+    }
+}
+
+void out_flush(void) {
+    out_raw(out_buf, out_len);
+    out_len = 0;
+}
+
+void out_write(const char *str, size_t len) {
+    if(out_len + len > OUT_BUFSIZE) {
+        out_flush();
+        if(len >= OUT_BUFSIZE) {
+            out_raw(str, len);
+            return;
+        }
+    }
+    memcpy(out_buf + out_len, str, len);
+    out_len += len;
+}
+
+void out_str(const char *str) {
+    if(str) {
+        out_write(str, strlen(str));
+    }
+}
+
+void out_char(char c) {
+    if(out_len == OUT_BUFSIZE) {
+        out_flush();
+    }
+    out_buf[out_len++] = c;
+}
+
+int out_error(void) {
+    return out_failed;
+}
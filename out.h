@@ -0,0 +1,16 @@
+#ifndef PACFIND_OUT_H
+#define PACFIND_OUT_H
+
+#include <stddef.h>
+
+/* standard output through one large buffer flushed with write(2); once a
+ * write fails all further output is dropped and out_error() is set */
+#define OUT_BUFSIZE (256 * 1024)
+
+void out_write(const char *str, size_t len);
+void out_str(const char *str);
+void out_char(char c);
+void out_flush(void);
+int out_error(void);
+
+#endif /* PACFIND_OUT_H */
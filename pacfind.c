@@ -1,18 +1,93 @@
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
 
 #include <regex.h>
 
 #include "alpm.h"
 #include <alpm_list.h>
 
+#include "bitset.h"
+#include "snapshot.h"
+#include "cache.h"
+#include "deps.h"
+#include "pool.h"
+#include "literal.h"
+#include "acmatch.h"
+#include "rx.h"
+#include "numindex.h"
+#include "units.h"
+#include "trigram.h"
+#include "pathindex.h"
+#include "out.h"
+#include "format.h"
+#include "daemon.h"
+#include "nameset.h"
+#include "conf.h"
+#include "syncdb.h"
+#include "localdb.h"
 #include "pacfind.h"
 
-alpm_list_t *all_pkgs = NULL;
+alpm_handle_t *handle = NULL;
+
+/* pacman.conf, read before the handle is created */
+conf_t *conf = NULL;
+
+/* set from --nocache; the path indexes are loaded long after the databases,
+ * and only if the query needs them */
+int nocache = 0;
+
+/* with --daemon every database stays loaded between queries, which are
+ * answered by forked children that set serving */
+resident_t *resident = NULL;
+size_t nresident = 0;
+int serving = 0;
+
+/* the text of --batch when it was read before the query ran: by a client of
+ * the daemon, or by the daemon's child from the client's request */
+const char *batch_text = NULL;
+
+/* every package in the loaded databases, indexed by a dense id */
+snapshot_t *snap = NULL;
+
+/* the packages being searched */
+bitset_t *all_pkgs = NULL;
+
+/* built on first use */
+satindex_t *satisfiers = NULL;
+depgraph_t *depends_graph = NULL;
+depgraph_t *requiredby_graph = NULL;
+
+/* list selectors expand through these, shared by every selector on the
+ * same list */
+depgraph_t *list_graphs[LCOL_COUNT] = { NULL };
+numindex_t *num_indexes[NCOL_COUNT] = { NULL };
+
+/* one index of file or backup paths per database in snap, or NULL if the
+ * database has no such lists */
+pathindex_t **path_indexes[2] = { NULL, NULL };
+
+/* leaf predicates are evaluated on these threads; each thread knows its
+ * index so it can use its own copy of per-worker state */
+pool_t *pool = NULL;
+size_t nworkers = 1;
+__thread size_t worker = 0;
+
+const rxengine_t *rxengine = NULL;
+
+/* the --format, --json or -0 template if one was given, and the -i layout */
+format_t *format = NULL;
+format_t *info_format = NULL;
+
+/* packages per task when a leaf is split across the pool */
+#define FILTER_CHUNK_WORDS 16
 
 typedef struct palette_t {
     char *base;
@@ -34,7 +109,7 @@ size_t strtrim(char *str)
     for(; end > start && isspace(*(end - 1)); end--);
 
     memmove(str, start, end - start);
-    *(end) = '\0';
+    str[end - start] = '\0';
 
     return end - start;
 }
@@ -44,6 +119,7 @@ node_t *node_new(ntype_t type, void *left, void *right) {
     n->type = type;
     n->left = left;
     n->right = right;
+    n->pred = NULL;
     return n;
 }
 
@@ -61,9 +137,15 @@ void node_free(node_t *node) {
         case OP_NOT:
             node_free(node->left);
             break;
+        case OP_TERMS:
+            alpm_list_free_inner(node->left, free);
+            alpm_list_free(node->left);
+            pred_free(node->pred);
+            break;
         default:
             free(node->left);
             free(node->right);
+            pred_free(node->pred);
             break;
     }
     free(node);
@@ -86,6 +168,25 @@ void usage(const char *msg) {
 "        -S     Search sync packages\n"
 "        -i     display extra pkg info\n"
 "        -q     display pkg name only\n"
+"        -r, --repo=REPO  only search REPO; may be repeated or comma separated,\n"
+"                     local names the installed packages\n"
+"        --config=FILE  read FILE instead of " CONF_FILE "\n"
+"        --reader=READER  read databases with native or alpm\n"
+"                     (default: native)\n"
+"        -j N   evaluate the query on N threads (default: one per core)\n"
+"        --nocache  read the databases without the cache\n"
+"        --regex-engine=ENGINE  posix, dfa or pcre2 (default: " REGEX_ENGINE_DEFAULT ")\n"
+"        --eval=MODE  stream packages through the query or evaluate it\n"
+"                     set by set (stream or sets, default: stream)\n"
+"        --limit N  stop after printing N packages\n"
+"        --format=FORMAT  print each package with a template, e.g.\n"
+"                     '%n %v %{isize}\\n'\n"
+"        --json     print packages as an array of JSON objects\n"
+"        -0         end each package with a NUL byte instead of a newline\n"
+"        --daemon   keep the databases loaded and answer queries on a socket\n"
+"        --remote   send the query to a running daemon, if there is one\n"
+"        --socket=PATH  the socket used by --daemon and --remote\n"
+"        --batch=FILE  run one query per line of FILE (- for stdin)\n"
 "\n"
 "    SYNTAX\n"
 "        [field] [cmp] value\n"
@@ -175,6 +276,9 @@ node_t *parse_node(int argc, char **argv, int *i) {
     }
 
     /* Handle pacman style queries */
+    if(*arg != '-' && (t == CMP_DEFAULT || t == CMP_RE)) {
+        return node_new(OP_TERMS, alpm_list_add(NULL, strdup(arg)), NULL);
+    }
     if(*arg != '-') {
         node_t *n1 = node_new(t, strdup("name"), strdup(arg));
         node_t *n2 = node_new(t, strdup("desc"), strdup(arg));
@@ -269,6 +373,18 @@ node_t *parse_query(int argc, char **argv, int *i) {
                 break;
         }
 
+        /* consecutive search terms are matched together */
+        if(op->type == OP_AND && node->type == OP_TERMS
+                && query && query->type == OP_AND && query->right
+                && ((node_t*) query->right)->type == OP_TERMS
+                && alpm_list_count(((node_t*) query->right)->left) < ACMATCH_MAX) {
+            node_t *terms = query->right;
+            terms->left = alpm_list_join(terms->left, node->left);
+            free(node);
+            free(op);
+            continue;
+        }
+
         op->left = query;
         op->right = node;
         query = op;
@@ -295,13 +411,26 @@ int parse_opts(int argc, char **argv, config_t *config) {
         {"quiet"      , no_argument       , NULL , 'q'} ,
         {"foreign"    , no_argument       , NULL , 'm'} ,
         {"list"       , optional_argument , NULL , 'l'} ,
-        {"repo"       , optional_argument , NULL , 'r'} ,
+        {"repo"       , required_argument , NULL , 'r'} ,
         {"groups"     , required_argument , NULL , 'g'} ,
         {"color"      , no_argument       , NULL , 'c'} ,
+        {"jobs"       , required_argument , NULL , 'j'} ,
+        {"nocache"    , no_argument       , NULL , OPT_NOCACHE} ,
+        {"regex-engine", required_argument, NULL , OPT_REGEX_ENGINE} ,
+        {"eval"       , required_argument , NULL , OPT_EVAL} ,
+        {"limit"      , required_argument , NULL , OPT_LIMIT} ,
+        {"format"     , required_argument , NULL , OPT_FORMAT} ,
+        {"json"       , no_argument       , NULL , OPT_JSON} ,
+        {"daemon"     , no_argument       , NULL , OPT_DAEMON} ,
+        {"remote"     , no_argument       , NULL , OPT_REMOTE} ,
+        {"socket"     , required_argument , NULL , OPT_SOCKET} ,
+        {"batch"      , required_argument , NULL , OPT_BATCH} ,
+        {"config"     , required_argument , NULL , OPT_CONFIG} ,
+        {"reader"     , required_argument , NULL , OPT_READER} ,
         {0, 0, 0, 0}
     };
 
-    while((c = getopt_long(argc, argv, "+QSqdeshmtug:ilr",
+    while((c = getopt_long(argc, argv, "+QSqdeshmtug:ilr:j:0",
                     long_options, &option_index)) != -1) {
 
         switch(c) {
@@ -355,11 +484,91 @@ int parse_opts(int argc, char **argv, config_t *config) {
                 config->info_level++;
                 break;
             case 'l':
+                break;
             case 'r':
-                /* config->repos->append(optarg) */
+                {
+                    char *repos = strdup(optarg), *repo;
+                    for(repo = strtok(repos, ","); repo; repo = strtok(NULL, ",")) {
+                        config->repos = alpm_list_add(config->repos, strdup(repo));
+                    }
+                    free(repos);
+                }
                 break;
             case 's':
                 break;
+            case 'j':
+                {
+                    char *end;
+                    errno = 0;
+                    config->jobs = strtol(optarg, &end, 10);
+                    if(errno || *end || config->jobs < 1) {
+                        usage("invalid job count");
+                    }
+                }
+                break;
+            case OPT_NOCACHE:
+                config->nocache = 1;
+                config->loadopts = 1;
+                break;
+            case OPT_REGEX_ENGINE:
+                config->regex_engine = optarg;
+                break;
+            case OPT_EVAL:
+                if(strcmp(optarg, "stream") == 0) {
+                    config->eval = EVAL_STREAM;
+                } else if(strcmp(optarg, "sets") == 0) {
+                    config->eval = EVAL_SETS;
+                } else {
+                    usage("invalid evaluation mode");
+                }
+                break;
+            case OPT_LIMIT:
+                {
+                    char *end;
+                    long limit;
+                    errno = 0;
+                    limit = strtol(optarg, &end, 10);
+                    if(errno || *end || limit < 1) {
+                        usage("invalid limit");
+                    }
+                    config->limit = limit;
+                }
+                break;
+            case OPT_FORMAT:
+                config->format = optarg;
+                break;
+            case OPT_JSON:
+                config->json = 1;
+                break;
+            case '0':
+                config->nul = 1;
+                break;
+            case OPT_DAEMON:
+                config->daemon = 1;
+                break;
+            case OPT_REMOTE:
+                config->remote = 1;
+                break;
+            case OPT_SOCKET:
+                config->socket = optarg;
+                break;
+            case OPT_BATCH:
+                config->batch = optarg;
+                break;
+            case OPT_CONFIG:
+                config->config_file = optarg;
+                config->loadopts = 1;
+                break;
+            case OPT_READER:
+                if(strcmp(optarg, "native") == 0) {
+                    config->reader = READER_NATIVE;
+                } else if(strcmp(optarg, "alpm") == 0) {
+                    config->reader = READER_ALPM;
+                } else {
+                    usage("invalid database reader");
+                }
+                config->loadopts = 1;
+                break;
             default:
                 break;
         }
@@ -367,27 +576,12 @@ int parse_opts(int argc, char **argv, config_t *config) {
     return optind;
 }
 
-int pcmp(const void *p1, const void *p2) {
-    if(p1 == p2) {
-        return 0;
-    }
-    if(p1 < p2) {
-        return -1;
-    }
-    return 1;
-}
-
-typedef int (*cmp_fn) (const void *, const void *);
-typedef char* (*prop_fn) (const void *);
-typedef alpm_list_t* (*list_fn) (const void *);
-typedef int (*eq_fn) (int);
-
-int regex_cmp(const char *val, regex_t *re) {
-    return regexec(re, val, 0, 0, 0);
+/* compares a value with the range a numeric query value denotes, so that
+ * -eq 2026-01-01 matches the whole day and -gt 2026-01-01 the days after */
+int rangecmp(const int64_t *value, const int64_t *range) {
+    return *value < range[0] ? -1 : *value > range[1];
 }
 
-int intcmp(long *i1, long *i2) { return *i2 - *i1; }
-
 int eq(int i) { return i == 0; }
 int ne(int i) { return i != 0; }
 int gt(int i) { return i > 0; }
@@ -395,545 +589,2331 @@ int ge(int i) { return i >= 0; }
 int lt(int i) { return i < 0; }
 int le(int i) { return i <= 0; }
 
-char *alpm_dep_get_name(alpm_depend_t *dep) { return dep->name; }
+satindex_t *get_satisfiers(void) {
+    if(satisfiers == NULL) {
+        satisfiers = satindex_new(snap, all_pkgs);
+    }
+    return satisfiers;
+}
 
-alpm_list_t *get_pkgs(char *selector, alpm_pkg_t *pkg, alpm_list_t *ret) {
-    char *end = strchr(selector, '.');
-    int recursive = 0;
-    field_t f;
-    list_fn lfn = NULL;
-    prop_fn pfn = (prop_fn) alpm_dep_compute_string;
-    int need_deep_free = 0;
+depgraph_t *get_depends_graph(void) {
+    if(depends_graph == NULL) {
+        depends_graph = depgraph_depends(snap, get_satisfiers());
+    }
+    return depends_graph;
+}
 
-    if(!end || end == selector) {
-        return ret;
+depgraph_t *get_requiredby_graph(void) {
+    if(requiredby_graph == NULL) {
+        requiredby_graph = depgraph_requiredby(snap);
     }
+    return requiredby_graph;
+}
 
-    if(*(end - 1) == '%') {
-        recursive = 1;
-        end--;
+numindex_t *get_numindex(numcol_t col) {
+    if(num_indexes[col] == NULL) {
+        num_indexes[col] = numindex_new(snap, col);
     }
+    return num_indexes[col];
+}
+
+/* sync packages have never been installed */
+int num_missing(int col, int64_t value) {
+    return col == NCOL_INSTALLDATE && value == 0;
+}
+
+long resolve_depend(size_t id, const snapitem_t *item) {
+    return satindex_find_item(get_satisfiers(), snap, id, item);
+}
+
+long resolve_depstring(size_t id, const snapitem_t *item) {
+    return satindex_find_string(get_satisfiers(), snap_item_str(snap, id, item->str));
+}
 
-    size_t j;
+int field_lookup(const char *name, size_t len, field_t *field) {
+    int j;
     for( j = 0; field_map[j].input; j++) {
-        if( strncmp(selector, field_map[j].input, end - selector) == 0 ) {
-            f = field_map[j].field;
-            break;
+        if( strncmp(name, field_map[j].input, len) == 0
+                && field_map[j].input[len] == '\0' ) {
+            *field = field_map[j].field;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void termset_free(termset_t *terms) {
+    size_t i;
+
+    if(terms == NULL) {
+        return;
+    }
+    for(i = 0; i < terms->count * TERM_FIELDS; i++) {
+        pred_free(terms->preds[i]);
+    }
+    free(terms->preds);
+    acmatch_free(terms->ac);
+    free(terms);
+}
+
+void pred_free(pred_t *pred) {
+    if(pred == NULL) {
+        return;
+    }
+    if(pred->shared) {
+        pred->shared--;
+        return;
+    }
+    if(pred->rx) {
+        size_t i;
+        for(i = 0; i < pred->nrx; i++) {
+            rx_free(&pred->rx[i]);
         }
+        free(pred->rx);
+    }
+    literal_free(pred->lit);
+    termset_free(pred->terms);
+    bitset_free(pred->hits);
+    bitset_free(pred->cand);
+    closure_free(pred->closure);
+    bitset_free(pred->tested);
+    bitset_free(pred->result);
+    pred_free(pred->next);
+    free(pred);
+}
+
+pred_t *pred_compile_selector(const char *fieldname, ntype_t type, const char *value) {
+    const char *end = strchr(fieldname, '.');
+    pred_t *pred = calloc(1, sizeof(pred_t));
+
+    pred->column = -1;
+    pred->list = -1;
+    pred->numcol = -1;
+    pred->pathkind = -1;
+    pred->rfn = (resolve_fn) resolve_depend;
+
+    if(end > fieldname && *(end - 1) == '%') {
+        pred->recursive = 1;
+        end--;
+    }
+
+    if(end == fieldname || field_lookup(fieldname, end - fieldname, &pred->field) != 0) {
+        printf("unimplemented selector: %s\n", fieldname);
+        free(pred);
+        return NULL;
     }
 
-    switch(f) {
+    switch(pred->field) {
         case DEPENDS:
-            lfn = (list_fn) alpm_pkg_get_depends;
+            pred->gfn = (graph_fn) get_depends_graph;
             break;
         case OPTDEPENDS:
-            lfn = (list_fn) alpm_pkg_get_optdepends;
-            pfn = (prop_fn) strdup;
+            pred->list = LCOL_OPTDEPENDS;
+            pred->rfn = (resolve_fn) resolve_depstring;
             break;
         case PROVIDES:
-            lfn = (list_fn) alpm_pkg_get_provides;
+            pred->list = LCOL_PROVIDES;
             break;
         case CONFLICTS:
-            lfn = (list_fn) alpm_pkg_get_conflicts;
+            pred->list = LCOL_CONFLICTS;
             break;
         case REPLACES:
-            lfn = (list_fn) alpm_pkg_get_replaces;
+            pred->list = LCOL_REPLACES;
             break;
         case REQUIREDBY:
-            lfn = (list_fn) alpm_pkg_compute_requiredby;
-            pfn = (prop_fn) strdup;
-            need_deep_free = 1;
+            pred->gfn = (graph_fn) get_requiredby_graph;
             break;
         default:
-            printf("unimplemented selector: %s\n", selector);
-            return ret;
+            printf("unimplemented selector: %s\n", fieldname);
+            free(pred);
+            return NULL;
             break;
     }
 
-    alpm_list_t *d, *plist = lfn(pkg);
-    for(d = plist; d; d = alpm_list_next(d) ) {
-        char *dep_string = pfn ? pfn(d->data) : d->data;;
-        alpm_pkg_t *s = alpm_find_satisfier(all_pkgs, dep_string);
-        free(dep_string);
-        if(!alpm_list_find_ptr(ret, s)) {
-            ret = alpm_list_add(ret, s);
-            if(recursive) {
-                ret = get_pkgs(selector, s, ret);
-            }
-        }
-    }
-    if(need_deep_free) {
-        FREELIST(plist);
+    if((pred->next = pred_compile(strchr(fieldname, '.') + 1, type, value)) == NULL) {
+        free(pred);
+        return NULL;
     }
 
-    return ret;
+    return pred;
 }
 
-alpm_list_t *filter_pkgs(node_t *cmp, alpm_list_t *pkgs) {
-    alpm_list_t *p = pkgs;
-    alpm_list_t *ret = NULL;
-
-    char *c;
-    int need_deep_free = 0;
-
-    long tmp;
+pred_t *pred_compile(const char *fieldname, ntype_t type, const char *value) {
+    pred_t *pred;
 
-    list_fn lfn = NULL;
-    prop_fn pfn = NULL;
-    cmp_fn cfn = (cmp_fn) strcmp;
-    eq_fn efn = NULL;
-
-    regex_t reg;
-
-    field_t field = 0;
-    char *fieldname = cmp->left;
-    void *value = cmp->right;
-
-    if((c = strchr(fieldname, '.'))) {
-        cmp->left = c + 1;
-        for(; pkgs; pkgs = alpm_list_next(pkgs)) {
-            p = get_pkgs(fieldname, pkgs->data, NULL);
-            alpm_list_t *m;
-            if(p && (m = filter_pkgs(cmp, p))) {
-                ret = alpm_list_add(ret, pkgs->data);
-                alpm_list_free(m);
-            }
-            alpm_list_free(p);
-        }
-        cmp->left = fieldname;
-        return ret;
+    if(strchr(fieldname, '.')) {
+        return pred_compile_selector(fieldname, type, value);
     }
 
-    int j;
-    for( j = 0; field_map[j].input; j++) {
-        if( strcmp(fieldname, field_map[j].input) == 0 ) {
-            field = field_map[j].field;
-            break;
-        }
+    pred = calloc(1, sizeof(pred_t));
+    pred->column = -1;
+    pred->list = -1;
+    pred->numcol = -1;
+    pred->pathkind = -1;
+    pred->cfn = (cmp_fn) strcmp;
+    pred->value = (void*) value;
+
+    if(field_lookup(fieldname, strlen(fieldname), &pred->field) != 0) {
+        printf("unimplemented field: %s\n", fieldname);
+        free(pred);
+        return NULL;
     }
 
-    switch(field) {
+    switch(pred->field) {
         case FILENAME:
-            pfn = (prop_fn) alpm_pkg_get_filename;
+            pred->column = SCOL_FILENAME;
             break;
         case NAME:
-            pfn = (prop_fn) alpm_pkg_get_name;
+            pred->column = SCOL_NAME;
             break;
         case DESC:
-            pfn = (prop_fn) alpm_pkg_get_desc;
+            pred->column = SCOL_DESC;
             break;
         case VERSION:
-            pfn = (prop_fn) alpm_pkg_get_version;
-            cfn = (cmp_fn) alpm_pkg_vercmp;
+            pred->column = SCOL_VERSION;
+            pred->cfn = (cmp_fn) alpm_pkg_vercmp;
             break;
         case URL:
-            pfn = (prop_fn) alpm_pkg_get_url;
+            pred->column = SCOL_URL;
+            break;
+        case BUILDDATE:
+            pred->numcol = NCOL_BUILDDATE;
+            break;
+        case INSTALLDATE:
+            pred->numcol = NCOL_INSTALLDATE;
             break;
-        /*case BUILDDATE:*/
-            /*pfn = (prop_fn) alpm_pkg_get_builddate;*/
-            /*cfn = (cmp_fn) intcmp;*/
-            /*tmp = atol(value);*/
-            /*value = &tmp;*/
-            /*break;*/
-        /*case INSTALLDATE:*/
-            /*pfn = (prop_fn) alpm_pkg_get_installdate;*/
-            /*cfn = (cmp_fn) intcmp;*/
-            /*tmp = atol(value);*/
-            /*value = &tmp;*/
-            /*break;*/
         case PACKAGER:
-            pfn = (prop_fn) alpm_pkg_get_packager;
+            pred->column = SCOL_PACKAGER;
             break;
         case MD5SUM:
-            pfn = (prop_fn) alpm_pkg_get_md5sum;
+            pred->column = SCOL_MD5SUM;
             break;
         case SHA256SUM:
-            pfn = (prop_fn) alpm_pkg_get_sha256sum;
+            pred->column = SCOL_SHA256SUM;
             break;
         case ARCH:
-            pfn = (prop_fn) alpm_pkg_get_arch;
+            pred->column = SCOL_ARCH;
+            break;
+        case SIZE:
+            pred->numcol = NCOL_SIZE;
+            break;
+        case ISIZE:
+            pred->numcol = NCOL_ISIZE;
             break;
-        /*case SIZE:*/
-            /*pfn = (prop_fn) alpm_pkg_get_size;*/
-            /*cfn = (cmp_fn) intcmp;*/
-            /*tmp = atol(value);*/
-            /*value = &tmp;*/
-            /*break;*/
-        /*case ISIZE:*/
-            /*pfn = (prop_fn) alpm_pkg_get_isize;*/
-            /*cfn = (cmp_fn) intcmp;*/
-            /*tmp = atol(value);*/
-            /*value = &tmp;*/
-            /*break;*/
         /*case BASE64SIG:*/
             /*pfn = (prop_fn) alpm_pkg_get_base64sig;*/
             /*cfn = (cmp_fn) strcmp;*/
             /*break;*/
 
         case LICENSE:
-            lfn = (list_fn) alpm_pkg_get_licenses;
-            pfn = NULL;
+            pred->list = LCOL_LICENSE;
             break;
         case GROUP:
-            lfn = (list_fn) alpm_pkg_get_groups;
-            pfn = NULL;
+            pred->list = LCOL_GROUP;
             break;
 
         case DEPENDS:
-            lfn = (list_fn) alpm_pkg_get_depends;
-            pfn = (prop_fn) alpm_dep_get_name;
+            pred->list = LCOL_DEPENDS;
             break;
         case OPTDEPENDS:
-            lfn = (list_fn) alpm_pkg_get_optdepends;
-            pfn = NULL;
+            pred->list = LCOL_OPTDEPENDS;
             break;
         case PROVIDES:
-            lfn = (list_fn) alpm_pkg_get_provides;
-            pfn = (prop_fn) alpm_dep_get_name;
+            pred->list = LCOL_PROVIDES;
             break;
         case REQUIREDBY:
-            lfn = (list_fn) alpm_pkg_compute_requiredby;
-            pfn = NULL;
-            need_deep_free = 1;
+            pred->gfn = (graph_fn) get_requiredby_graph;
+            pred->column = SCOL_NAME;
             break;
         case CONFLICTS:
-            lfn = (list_fn) alpm_pkg_get_conflicts;
-            pfn = (prop_fn) alpm_dep_get_name;
+            pred->list = LCOL_CONFLICTS;
             break;
         case REPLACES:
-            lfn = (list_fn) alpm_pkg_get_replaces;
-            pfn = (prop_fn) alpm_dep_get_name;
+            pred->list = LCOL_REPLACES;
+            break;
+
+        case FILES:
+            pred->pathkind = PATH_FILES;
+            break;
+        case BACKUP:
+            pred->pathkind = PATH_BACKUP;
             break;
 
         default:
             printf("unimplemented field: %s\n", fieldname);
+            free(pred);
             return NULL;
             break;
     }
 
-    if(cmp->type == CMP_DEFAULT) {
-        cmp->type = CMP_RE;
+    if(type == CMP_DEFAULT) {
+        type = pred->numcol >= 0 ? CMP_EQ : CMP_RE;
+    }
+    pred->type = type;
+
+    if(pred->numcol >= 0) {
+        int err = pred->numcol == NCOL_SIZE || pred->numcol == NCOL_ISIZE
+            ? units_size(value, pred->range)
+            : units_date(value, time(NULL), pred->range);
+        if(type == CMP_RE || type == CMP_NR) {
+            printf("bad cmp\n");
+            free(pred);
+            return NULL;
+        }
+        if(err != 0) {
+            printf("invalid %s: %s\n", fieldname, value);
+            free(pred);
+            return NULL;
+        }
     }
 
-    switch(cmp->type) {
+    switch(pred->type) {
         case CMP_EQ:
-            efn = (eq_fn) eq;
+            pred->efn = (eq_fn) eq;
             break;
         case CMP_NE:
-            efn = (eq_fn) ne;
+            pred->efn = (eq_fn) ne;
             break;
         case CMP_GT:
-            efn = (eq_fn) gt;
+            pred->efn = (eq_fn) gt;
             break;
         case CMP_GE:
-            efn = (eq_fn) ge;
+            pred->efn = (eq_fn) ge;
             break;
         case CMP_LT:
-            efn = (eq_fn) lt;
+            pred->efn = (eq_fn) lt;
             break;
         case CMP_LE:
-            efn = (eq_fn) le;
+            pred->efn = (eq_fn) le;
             break;
         case CMP_RE:
         case CMP_NR:
-            if(regcomp(&reg, (char*) value, REG_EXTENDED | REG_NOSUB | REG_ICASE | REG_NEWLINE) != 0)
-                return NULL;
-            value = &reg;
-            cfn = (cmp_fn) regex_cmp;
-            efn = cmp->type == CMP_RE ? (eq_fn) eq : (eq_fn) ne;
+            pred->efn = pred->type == CMP_RE ? (eq_fn) eq : (eq_fn) ne;
+            if((pred->lit = literal_compile(value))) {
+                break;
+            }
+            /* matchers keep scratch state (glibc even locks the pattern),
+             * so every worker gets its own copy */
+            pred->rx = calloc(nworkers, sizeof(rx_t));
+            for(pred->nrx = 0; pred->nrx < nworkers; pred->nrx++) {
+                if(rx_compile(&pred->rx[pred->nrx], rxengine, value) != 0) {
+                    printf("invalid regex: %s\n", value);
+                    pred_free(pred);
+                    return NULL;
+                }
+            }
             break;
         default:
-            printf("field: %s\n", field);
-            printf("value: %s\n", value);
             printf("bad cmp\n");
+            free(pred);
             return NULL;
             break;
     }
 
-    if(lfn) {
-        for(; p; p = alpm_list_next(p)) {
-            alpm_list_t *plist = lfn(p->data);
-            alpm_list_t *l;
-            for(l = plist; l; l = alpm_list_next(l) ) {
-                void *prop = pfn ? pfn(l->data) : l->data;
-                if(efn(cfn(prop, value))) {
-                    ret = alpm_list_add(ret, p->data);
-                    break;
-                }
-            }
-            if(need_deep_free) {
-                FREELIST(plist);
-            }
+    return pred;
+}
+
+pred_t *pred_compile_terms(alpm_list_t *values) {
+    static const char *fields[TERM_FIELDS] = { "name", "desc", "provides", "group" };
+    termset_t *terms = calloc(1, sizeof(termset_t));
+    pred_t *pred = calloc(1, sizeof(pred_t));
+    alpm_list_t *v;
+    size_t t, f;
+
+    pred->type = CMP_RE;
+    pred->column = -1;
+    pred->list = -1;
+    pred->numcol = -1;
+    pred->pathkind = -1;
+    pred->terms = terms;
+
+    terms->count = alpm_list_count(values);
+    terms->preds = calloc(terms->count * TERM_FIELDS, sizeof(pred_t*));
+    terms->ac = acmatch_new();
+
+    for(v = values, t = 0; v; v = alpm_list_next(v), t++) {
+        const char *value = v->data;
+        literal_t *lit = literal_compile(value);
+
+        if(lit && lit->anchor == LIT_ANY) {
+            acmatch_add(terms->ac, lit->needle, lit->len, t);
+            terms->acmask |= (uint64_t) 1 << t;
+            literal_free(lit);
+            continue;
         }
-    } else {
-        for(; p; p = alpm_list_next(p)) {
-            void *prop = pfn(p->data);
+        literal_free(lit);
 
-            if(prop && efn(cfn(prop, value))) {
-                ret = alpm_list_add(ret, p->data);
+        for(f = 0; f < TERM_FIELDS; f++) {
+            if(!(terms->preds[t * TERM_FIELDS + f] = pred_compile(fields[f], CMP_RE, value))) {
+                pred_free(pred);
+                return NULL;
             }
         }
     }
+    acmatch_compile(terms->ac);
 
-    if(cmp->type == CMP_RE || cmp->type == CMP_NR) {
-        regfree(value);
-    }
-
-    return ret;
+    return pred;
 }
 
-alpm_list_t *run_query(node_t *query, alpm_list_t *pkgs) {
-    if( query == NULL ) {
-        return alpm_list_copy(pkgs);
+int compile_query(node_t *query) {
+    if(query == NULL) {
+        return 0;
     }
 
-    alpm_list_t *left;
-    alpm_list_t *right;
-
     switch(query->type) {
         case OP_AND:
-            left = run_query(query->left, pkgs);
-            right = run_query(query->right, left);
-            alpm_list_free(left);
-            return right;
-            break;
         case OP_OR:
-            left = run_query(query->left, pkgs);
-            right = run_query(query->right, pkgs);
-            pkgs = alpm_list_join(left, right);
-            pkgs = alpm_list_remove_dupes(pkgs);
-            return pkgs;
-            break;
         case OP_XOR:
-            left = run_query(query->left, pkgs);
-            pkgs = alpm_list_diff(pkgs, left, pcmp);
-            right = run_query(query->right, pkgs);
-            alpm_list_free(left);
-            alpm_list_free(pkgs);
-            return right;
+            if(compile_query(query->left) != 0) {
+                return -1;
+            }
+            return compile_query(query->right);
             break;
         case OP_NOT:
-            left = run_query(query->left, pkgs);
-            pkgs = alpm_list_diff(pkgs, left, pcmp);
-            alpm_list_free(left);
-            return pkgs;
+            return compile_query(query->left);
+            break;
+        case OP_TERMS:
+            if(query->pred == NULL) {
+                query->pred = pred_compile_terms(query->left);
+            }
+            return query->pred ? 0 : -1;
+            break;
+        default:
             break;
     }
 
-    return filter_pkgs(query, pkgs);
-}
-
-alpm_list_t *build_pkg_list(alpm_handle_t *handle, config_t *config, alpm_list_t *names) {
-    alpm_list_t *pkgs = NULL;
-    alpm_list_t *dblist = NULL;
-
-    FILE *fp;
-    fp = fopen("/etc/pacman.conf", "r");
-    char line[512];
-    const alpm_siglevel_t level = ALPM_SIG_DATABASE | ALPM_SIG_DATABASE_OPTIONAL;
-
-    while(fgets(line, 512, fp)) {
-        size_t linelen;
-        char *ptr;
-
-        if((ptr = strchr(line, '#'))) {
-            *ptr = '\0';
-        }
-
-        linelen = strtrim(line);
-
-        if(linelen < 3) {
-            continue;
-        }
+    if(query->pred == NULL) {
+        query->pred = pred_compile(query->left, query->type, query->right);
+    }
 
-        if(line[0] == '[' && line[linelen - 1] == ']') {
-            line[linelen - 1] = '\0';
-            ptr = line + 1;
+    return query->pred ? 0 : -1;
+}
 
-            if(strcmp(ptr, "options") != 0) {
-                alpm_register_syncdb(handle, ptr, level);
+/* estimated cost of testing one package against a leaf, in units of a
+ * literal comparison, and the fraction of packages expected to pass */
+void pred_estimate(pred_t *pred, double *cost, double *sel) {
+    double c = 0, s;
+
+    if(pred->terms) {
+        size_t t;
+        *cost = 4;
+        *sel = 1;
+        for(t = 0; t < pred->terms->count; t++) {
+            if(!(pred->terms->acmask & ((uint64_t) 1 << t))) {
+                *cost += 12;
             }
+            *sel *= 0.1;
         }
+        return;
     }
 
-    fclose(fp);
+    for(; pred->next; pred = pred->next) {
+        c += pred->recursive ? 50 : 10;
+    }
 
-    if(config->sync && !(config->depends || config->explicit || config->unneeded || config->foreign)) {
-        dblist = alpm_list_join(dblist, alpm_list_copy(alpm_get_syncdbs(handle)));
+    if(pred->gfn) {
+        c += 8;
+    } else if(pred->numcol >= 0 || pred->pathkind >= 0) {
+        c += 0.25;
+    } else if(pred->list >= 0) {
+        c += 4;
+    } else {
+        c += 1;
     }
-    if(config->local) {
-        dblist = alpm_list_add(dblist, alpm_get_localdb(handle));
+    if(pred->rx) {
+        c *= 3;
     }
 
-    alpm_list_t *d;
-    for(d = dblist; d; d = alpm_list_next(d)) {
-        alpm_list_t *p = alpm_db_get_pkgcache(d->data);
-        if(names) {
-            alpm_list_t *n;
-            for(n = names; n; n = alpm_list_next(n)) {
-                char *name = n->data;
-                char *s = strchr(name, '/');
-
-                if(s) {
-                    if(strncmp(name, alpm_db_get_name(d->data), s - name - 1) != 0) {
-                        continue;
-                    }
-                    name = s + 1;
-                }
-
-                alpm_list_t *p2 = p;
-                for( ; p2; p2 = alpm_list_next(p2)) {
-                    if(strcmp(alpm_pkg_get_name(p2->data), name) == 0) {
-                        pkgs = alpm_list_add(pkgs, p2->data);
-                    }
-                }
-            }
-        }
-        else {
-            for( ; p; p = alpm_list_next(p)) {
-                if(!names || alpm_list_find_str(names, alpm_pkg_get_name(p->data))) {
-                    pkgs = alpm_list_add(pkgs, p->data);
-                }
-            }
-        }
+    switch(pred->type) {
+        case CMP_EQ:
+            s = 0.01;
+            break;
+        case CMP_NE:
+            s = 0.99;
+            break;
+        case CMP_RE:
+            s = 0.1;
+            break;
+        case CMP_NR:
+            s = 0.9;
+            break;
+        default:
+            s = 0.5;
+            break;
     }
 
-    alpm_list_free(dblist);
-
-    return pkgs;
+    *cost = c;
+    *sel = s;
 }
 
-void dump_pkg_short(alpm_pkg_t *pkg, int verbosity) {
-    if(verbosity < 0) {
-        puts(alpm_pkg_get_name(pkg));
-    } else {
-        alpm_list_t *groups = alpm_pkg_get_groups(pkg);
-        printf("%s%s%s/%s%s %s%s%s",
-                palette.repo, alpm_db_get_name(alpm_pkg_get_db(pkg)),
-                palette.base,
-                palette.pkgname, alpm_pkg_get_name(pkg),
-                palette.pkgver, alpm_pkg_get_version(pkg),
-                palette.base);
-        if(groups) {
-            fputs(palette.groups, stdout);
-            fputs(" (", stdout);
-            while(groups) {
-                fputs(groups->data, stdout);
-                groups = groups->next;
-                if(groups) {
-                    fputs(", ", stdout);
-                }
-            }
-            fputs(")", stdout);
-            fputs(palette.base, stdout);
-        }
+void node_estimate(node_t *node, double *cost, double *sel) {
+    double lc, ls, rc, rs;
+
+    if(node == NULL) {
+        *cost = 0;
+        *sel = 1;
+        return;
+    }
 
-        printf("\n    %s\n", alpm_pkg_get_desc(pkg));
+    switch(node->type) {
+        case OP_AND:
+            node_estimate(node->left, &lc, &ls);
+            node_estimate(node->right, &rc, &rs);
+            *cost = lc + ls * rc;
+            *sel = ls * rs;
+            break;
+        case OP_OR:
+            node_estimate(node->left, &lc, &ls);
+            node_estimate(node->right, &rc, &rs);
+            *cost = lc + (1 - ls) * rc;
+            *sel = ls + rs - ls * rs;
+            break;
+        case OP_XOR:
+            node_estimate(node->left, &lc, &ls);
+            node_estimate(node->right, &rc, &rs);
+            *cost = lc + rc;
+            *sel = ls + rs - 2 * ls * rs;
+            break;
+        case OP_NOT:
+            node_estimate(node->left, cost, &ls);
+            *sel = 1 - ls;
+            break;
+        default:
+            pred_estimate(node->pred, cost, sel);
+            break;
     }
 }
 
-void dump_pkg_full(alpm_pkg_t *pkg, int verbosity) {
-    dump_pkg_short(pkg, verbosity);
-}
+/* a leaf can absorb a -not by inverting its comparison only if it tests a
+ * single value every package has; list and selector fields test whether
+ * any entry matches, and missing values fail every comparison */
+int node_negatable(node_t *node) {
+    pred_t *pred;
 
-void print_pkgs(alpm_list_t *pkgs, config_t *config) {
-    int verbosity = config ? config->info_level - config->quiet : 0;
-    if(pkgs == NULL) {
-        return;
+    if(node == NULL) {
+        return 0;
     }
 
-    pkgs = alpm_list_remove_dupes(pkgs);
+    switch(node->type) {
+        case OP_NOT:
+            return 1;
+        case OP_AND:
+        case OP_OR:
+            return node_negatable(node->left) && node_negatable(node->right);
+        case OP_XOR:
+        case OP_TERMS:
+            return 0;
+        default:
+            break;
+    }
 
-    alpm_list_t *i;
-    if(config && config->info_level) {
-        for(i = pkgs; i; i = alpm_list_next(i)) {
-            dump_pkg_full(i->data, verbosity);
-        }
-    } else {
-        for(i = pkgs; i; i = alpm_list_next(i)) {
-            dump_pkg_short(i->data, verbosity);
-        }
+    pred = node->pred;
+    if(pred->next || pred->gfn || pred->list >= 0) {
+        return 0;
     }
-    alpm_list_free(pkgs);
+    return pred->column == SCOL_NAME || pred->column == SCOL_VERSION
+        || (pred->numcol >= 0 && pred->numcol != NCOL_INSTALLDATE);
 }
 
-int main(int argc, char **argv) {
-    config_t config = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-    config.local = 1;
-    config.sync = 1;
-    node_t *query;
-    int i;
-    alpm_list_t *matched = NULL;
-    alpm_list_t *names = NULL;
+node_t *node_negate(node_t *node) {
+    static const struct {
+        ntype_t type;
+        eq_fn efn;
+        ntype_t neg;
+        eq_fn nefn;
+    } inverse[] = {
+        {CMP_EQ, (eq_fn) eq, CMP_NE, (eq_fn) ne},
+        {CMP_NE, (eq_fn) ne, CMP_EQ, (eq_fn) eq},
+        {CMP_GT, (eq_fn) gt, CMP_LE, (eq_fn) le},
+        {CMP_LE, (eq_fn) le, CMP_GT, (eq_fn) gt},
+        {CMP_GE, (eq_fn) ge, CMP_LT, (eq_fn) lt},
+        {CMP_LT, (eq_fn) lt, CMP_GE, (eq_fn) ge},
+        {CMP_RE, (eq_fn) eq, CMP_NR, (eq_fn) ne},
+        {CMP_NR, (eq_fn) ne, CMP_RE, (eq_fn) eq},
+    };
+    node_t *child;
+    size_t i;
 
-    if(!isatty(fileno(stdin))) {
-        char buffer[512];
-        while(fgets(buffer, 512, stdin)) {
-            if(strtrim(buffer)) {
-                names = alpm_list_add(names, strdup(buffer));
-            }
+    switch(node->type) {
+        case OP_NOT:
+            child = node->left;
+            free(node);
+            return child;
+        case OP_AND:
+        case OP_OR:
+            node->type = node->type == OP_AND ? OP_OR : OP_AND;
+            node->left = node_negate(node->left);
+            node->right = node_negate(node->right);
+            return node;
+        default:
+            break;
+    }
+
+    for(i = 0; i < sizeof(inverse) / sizeof(inverse[0]); i++) {
+        if(node->pred->type == inverse[i].type) {
+            node->pred->type = inverse[i].neg;
+            node->pred->efn = inverse[i].nefn;
+            node->type = inverse[i].neg;
+            break;
         }
     }
+    return node;
+}
 
-    /*alpm_errno_t err;*/
+typedef struct operand_t {
+    node_t *node;
+    double rank;
+} operand_t;
 
-    i = parse_opts(argc, argv, &config);
-    alpm_handle_t *handle = alpm_initialize("/", "/var/lib/pacman", NULL);
-    query = parse_query(argc, argv, &i);
-    all_pkgs = build_pkg_list(handle, &config, names);
+int operand_cmp(const void *a, const void *b) {
+    double ra = ((const operand_t*) a)->rank, rb = ((const operand_t*) b)->rank;
+    return ra < rb ? -1 : ra > rb;
+}
+
+/* gathers the operands of a chain of nodes of one type, freeing the chain */
+void node_collect(node_t *node, ntype_t type, operand_t **ops, size_t *count, size_t *size) {
+    if(node && node->type == type) {
+        node_collect(node->left, type, ops, count, size);
+        node_collect(node->right, type, ops, count, size);
+        free(node);
+        return;
+    }
+    /* an empty query on the left of an -and matches everything */
+    if(node == NULL && type == OP_AND) {
+        return;
+    }
+    if(*count == *size) {
+        *size *= 2;
+        *ops = realloc(*ops, *size * sizeof(operand_t));
+    }
+    (*ops)[(*count)++].node = node;
+}
+
+int node_has_null(node_t *node, ntype_t type) {
+    if(node == NULL) {
+        return 1;
+    }
+    if(node->type != type) {
+        return 0;
+    }
+    return node_has_null(node->left, type) || node_has_null(node->right, type);
+}
+
+/* rewrites the query so that it is cheaper to run: -not is pushed into the
+ * leaves that can absorb it, and the operands of -and/-or chains are
+ * ordered so that cheap, decisive tests run first and the expensive ones
+ * only see the packages that are still undecided */
+node_t *optimize_query(node_t *node) {
+    operand_t *ops;
+    size_t count = 0, size = 8, i;
+    ntype_t type;
+
+    if(node == NULL) {
+        return NULL;
+    }
+
+    switch(node->type) {
+        case OP_NOT:
+            node->left = optimize_query(node->left);
+            if(node_negatable(node->left)) {
+                node_t *child = node->left;
+                free(node);
+                return optimize_query(node_negate(child));
+            }
+            return node;
+        case OP_XOR:
+            node->left = optimize_query(node->left);
+            node->right = optimize_query(node->right);
+            return node;
+        case OP_AND:
+        case OP_OR:
+            /* an empty query on either side of an -or matches everything;
+             * leave those alone */
+            if(node->type == OP_OR && node_has_null(node, OP_OR)) {
+                return node;
+            }
+            break;
+        default:
+            return node;
+    }
+
+    type = node->type;
+    ops = malloc(size * sizeof(operand_t));
+    node_collect(node, type, &ops, &count, &size);
+
+    for(i = 0; i < count; i++) {
+        double cost, sel;
+        ops[i].node = optimize_query(ops[i].node);
+        node_estimate(ops[i].node, &cost, &sel);
+        /* -and wants to drop packages early, -or to accept them early */
+        if(type == OP_AND) {
+            ops[i].rank = sel < 1 ? cost / (1 - sel) : HUGE_VAL;
+        } else {
+            ops[i].rank = sel > 0 ? cost / sel : HUGE_VAL;
+        }
+    }
+    qsort(ops, count, sizeof(operand_t), operand_cmp);
+
+    node = count ? ops[0].node : NULL;
+    for(i = 1; i < count; i++) {
+        node = node_new(type, node, ops[i].node);
+    }
+    free(ops);
+
+    return node;
+}
+
+uint64_t hash_str(uint64_t h, const char *str) {
+    do {
+        h ^= (unsigned char) *str;
+        h *= 1099511628211ULL;
+    } while(*str++);
+    return h;
+}
+
+uint64_t leaf_hash(node_t *node) {
+    uint64_t h = 14695981039346656037ULL ^ node->type;
+    alpm_list_t *v;
+
+    if(node->type == OP_TERMS) {
+        for(v = node->left; v; v = alpm_list_next(v)) {
+            h = hash_str(h, v->data);
+        }
+        return h;
+    }
+    return hash_str(hash_str(h, node->left), node->right);
+}
+
+int leaf_same(node_t *a, node_t *b) {
+    alpm_list_t *i, *j;
+
+    if(a->type != b->type) {
+        return 0;
+    }
+    if(a->type != OP_TERMS) {
+        return strcmp(a->left, b->left) == 0 && strcmp(a->right, b->right) == 0;
+    }
+    for(i = a->left, j = b->left; i && j; i = alpm_list_next(i), j = alpm_list_next(j)) {
+        if(strcmp(i->data, j->data) != 0) {
+            return 0;
+        }
+    }
+    return i == NULL && j == NULL;
+}
+
+size_t leaf_count(node_t *node) {
+    if(node == NULL) {
+        return 0;
+    }
+    switch(node->type) {
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+            return leaf_count(node->left) + leaf_count(node->right);
+        case OP_NOT:
+            return leaf_count(node->left);
+        default:
+            return 1;
+    }
+}
+
+/* the leaf table of one query, or with --batch of every query so far; a
+ * kept table owns its own copy of each leaf and a reference to its pred */
+typedef struct leaftab_t {
+    node_t **slots;
+    size_t size;
+    size_t count;
+    int keep;
+} leaftab_t;
+
+leaftab_t *leaf_cache = NULL;
+
+void leaftab_insert(leaftab_t *tab, node_t *node) {
+    size_t h;
+    for(h = leaf_hash(node) & (tab->size - 1); tab->slots[h]; h = (h + 1) & (tab->size - 1));
+    tab->slots[h] = node;
+    tab->count++;
+}
+
+void leaftab_reserve(leaftab_t *tab, size_t n) {
+    node_t **old = tab->slots;
+    size_t size = tab->size, i;
+
+    if(tab->size >= 2 * (tab->count + n)) {
+        return;
+    }
+    if(tab->size == 0) {
+        tab->size = 16;
+    }
+    while(tab->size < 2 * (tab->count + n)) {
+        tab->size *= 2;
+    }
+    tab->slots = calloc(tab->size, sizeof(node_t*));
+    tab->count = 0;
+    for(i = 0; i < size; i++) {
+        if(old[i]) {
+            leaftab_insert(tab, old[i]);
+        }
+    }
+    free(old);
+}
+
+void leaftab_free(leaftab_t *tab) {
+    size_t i;
+
+    if(tab == NULL) {
+        return;
+    }
+    if(tab->keep) {
+        for(i = 0; i < tab->size; i++) {
+            node_free(tab->slots[i]);
+        }
+    }
+    free(tab->slots);
+    free(tab);
+}
+
+/* moves a leaf's text, which its pred may point into, to a node the table
+ * keeps and gives the query's node a copy */
+node_t *leaf_keep(node_t *node) {
+    node_t *kept = node_new(node->type, node->left, node->right);
+    alpm_list_t *v;
+
+    kept->pred = node->pred;
+    kept->pred->shared++;
+    if(node->type == OP_TERMS) {
+        node->left = NULL;
+        for(v = kept->left; v; v = alpm_list_next(v)) {
+            node->left = alpm_list_add(node->left, strdup(v->data));
+        }
+    } else {
+        node->left = strdup(kept->left);
+        node->right = strdup(kept->right);
+    }
+    return kept;
+}
+
+void share_leaves_r(node_t *node, leaftab_t *tab) {
+    size_t h, mask = tab->size - 1;
+
+    if(node == NULL) {
+        return;
+    }
+    switch(node->type) {
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+            share_leaves_r(node->left, tab);
+            share_leaves_r(node->right, tab);
+            return;
+        case OP_NOT:
+            share_leaves_r(node->left, tab);
+            return;
+        default:
+            break;
+    }
+
+    for(h = leaf_hash(node) & mask; tab->slots[h]; h = (h + 1) & mask) {
+        if(leaf_same(tab->slots[h], node)) {
+            pred_t *pred = tab->slots[h]->pred;
+            if(pred->tested == NULL) {
+                pred->tested = bitset_new(snap->count);
+                pred->result = bitset_new(snap->count);
+            }
+            pred_free(node->pred);
+            node->pred = pred;
+            pred->shared++;
+            return;
+        }
+    }
+    if(tab->keep) {
+        /* results are remembered for the queries that follow */
+        node->pred->tested = bitset_new(snap->count);
+        node->pred->result = bitset_new(snap->count);
+        tab->slots[h] = leaf_keep(node);
+    } else {
+        tab->slots[h] = node;
+    }
+    tab->count++;
+}
+
+/* hash-conses identical leaves so that each is tested at most once per
+ * package however often it appears in the query, or with --batch in any
+ * query of the batch; run after optimize_query since negation rewrites
+ * leaves in place */
+void share_leaves(node_t *query) {
+    leaftab_t local = { NULL, 0, 0, 0 };
+    leaftab_t *tab = leaf_cache ? leaf_cache : &local;
+
+    leaftab_reserve(tab, leaf_count(query));
+    share_leaves_r(query, tab);
+    free(local.slots);
+}
+
+/* expands a list selector into edges from every package to the searched
+ * packages that satisfy its entries */
+depgraph_t *get_pkgs(pred_t *selector) {
+    depgraph_t *graph;
+    bitset_t *seen;
+    size_t id, size = 1024, nedges = 0;
+
+    if(selector->gfn) {
+        return selector->gfn();
+    }
+    if(list_graphs[selector->list]) {
+        return list_graphs[selector->list];
+    }
+
+    graph = calloc(1, sizeof(depgraph_t));
+    graph->count = snap->count;
+    graph->offsets = malloc((snap->count + 1) * sizeof(uint32_t));
+    graph->edges = malloc(size * sizeof(uint32_t));
+    seen = bitset_new(snap->count);
+
+    for(id = 0; id < snap->count; id++) {
+        size_t i, nitems;
+        const snapitem_t *items = snap_list(snap, selector->list, id, &nitems);
+        uint32_t e;
+
+        graph->offsets[id] = nedges;
+        for(i = 0; i < nitems; i++) {
+            long s = selector->rfn(id, items + i);
+            if(s < 0 || bitset_test(seen, s)) {
+                continue;
+            }
+            bitset_set(seen, s);
+            if(nedges == size) {
+                size *= 2;
+                graph->edges = realloc(graph->edges, size * sizeof(uint32_t));
+            }
+            graph->edges[nedges++] = s;
+        }
+        for(e = graph->offsets[id]; e < nedges; e++) {
+            bitset_unset(seen, graph->edges[e]);
+        }
+    }
+    graph->offsets[snap->count] = nedges;
+
+    bitset_free(seen);
+    return list_graphs[selector->list] = graph;
+}
+
+int pred_test_str(pred_t *pred, const char *prop, size_t len) {
+    if(pred->lit) {
+        return pred->efn(!literal_match(pred->lit, prop, len));
+    }
+    if(pred->rx) {
+        return pred->efn(!rx_exec(&pred->rx[worker], prop, len));
+    }
+    return pred->efn(pred->cfn(prop, pred->value));
+}
+
+/* the packages a numeric comparison selects, found with binary searches of
+ * the column's index rather than a scan: the values below, inside and
+ * above the range are contiguous runs of the index */
+bitset_t *num_hits(pred_t *pred) {
+    numindex_t *idx = get_numindex(pred->numcol);
+    size_t bounds[4], i;
+    int run;
+
+    bounds[0] = 0;
+    bounds[1] = numindex_lower(idx, pred->range[0]);
+    bounds[2] = numindex_upper(idx, pred->range[1]);
+    bounds[3] = idx->count;
+
+    pred->hits = bitset_new(snap->count);
+    for(run = 0; run < 3; run++) {
+        if(!pred->efn(run - 1)) {
+            continue;
+        }
+        for(i = bounds[run]; i < bounds[run + 1]; i++) {
+            if(!num_missing(pred->numcol, idx->values[i])) {
+                bitset_set(pred->hits, idx->ids[i]);
+            }
+        }
+    }
+
+    return pred->hits;
+}
+
+int pkgname_cmp(const void *a, const void *b) {
+    return strcmp(snap_str(snap, SCOL_NAME, *(const uint32_t*) a),
+            snap_str(snap, SCOL_NAME, *(const uint32_t*) b));
+}
+
+/* the index names its packages; find them among the packages of database
+ * d, which may have been read in a different order */
+void bind_pathindex(pathindex_t *idx, size_t d) {
+    size_t first = snap->base[d], count = snap->dbs[d]->count, i;
+    uint32_t *order = malloc((count ? count : 1) * sizeof(uint32_t));
+
+    for(i = 0; i < count; i++) {
+        order[i] = first + i;
+    }
+    qsort(order, count, sizeof(uint32_t), pkgname_cmp);
+
+    idx->ids = malloc((idx->npkgs ? idx->npkgs : 1) * sizeof(uint32_t));
+    for(i = 0; i < idx->npkgs; i++) {
+        const char *name = pathindex_pkgname(idx, i);
+        size_t lo = 0, hi = count;
+        while(lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if(strcmp(snap_str(snap, SCOL_NAME, order[mid]), name) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        idx->ids[i] = lo < count && strcmp(snap_str(snap, SCOL_NAME, order[lo]), name) == 0
+            ? order[lo] : UINT32_MAX;
+    }
+
+    free(order);
+}
+
+/* a handle of its own for reading one sync database, so it can be read
+ * alongside others or with another extension.  The database is validated
+ * here, since checking signatures is not safe on several threads at once */
+alpm_handle_t *syncdb_handle(const char *dbname, const char *ext, alpm_db_t **alpmdb) {
+    const confrepo_t *repo = conf_repo(conf, dbname);
+    alpm_handle_t *h;
+
+    *alpmdb = NULL;
+    if((h = alpm_initialize(alpm_option_get_root(handle),
+                    alpm_option_get_dbpath(handle), NULL)) == NULL) {
+        return NULL;
+    }
+    if(ext) {
+        alpm_option_set_dbext(h, ext);
+    }
+    *alpmdb = alpm_register_syncdb(h, dbname, repo ? repo->siglevel : conf->siglevel);
+    if(*alpmdb) {
+        alpm_db_get_valid(*alpmdb);
+    }
+    return h;
+}
+
+/* file lists come from the local database and the sync .files databases,
+ * read through a second handle since a handle only has one extension;
+ * backup lists only exist for installed packages */
+pathindex_t *load_pathindex(size_t d, pathkind_t kind) {
+    const char *dbpath = alpm_option_get_dbpath(handle);
+    const dbsnap_t *sdb = snap->dbs[d];
+    alpm_handle_t *files = NULL;
+    alpm_db_t *alpmdb;
+    pathindex_t *idx = NULL;
+    cachekey_t key;
+    char name[512];
+    int keyed;
+
+    snprintf(name, sizeof(name), "%s.%s", sdb->dbname, kind == PATH_FILES ? "files" : "backup");
+    if(sdb->local) {
+        keyed = cache_key_local(dbpath, &key) == 0;
+    } else if(kind == PATH_FILES && cache_key_files(dbpath, sdb->dbname, &key) == 0) {
+        keyed = 1;
+    } else {
+        return NULL;
+    }
+
+    if(!nocache && keyed) {
+        idx = pathindex_load(name, kind, &key);
+    }
+    if(idx == NULL) {
+        if(sdb->local) {
+            alpmdb = alpm_get_localdb(handle);
+        } else {
+            files = syncdb_handle(sdb->dbname, ".files", &alpmdb);
+        }
+        if(alpmdb) {
+            idx = pathindex_from_alpm(alpmdb, kind);
+        }
+        if(idx && !nocache && keyed) {
+            pathindex_save(idx, name, &key);
+        }
+        if(files) {
+            alpm_release(files);
+        }
+    }
+
+    if(idx) {
+        bind_pathindex(idx, d);
+    }
+    return idx;
+}
+
+pathindex_t **get_pathindexes(pathkind_t kind) {
+    size_t d;
+
+    if(path_indexes[kind] == NULL) {
+        path_indexes[kind] = calloc(snap->ndbs ? snap->ndbs : 1, sizeof(pathindex_t*));
+        for(d = 0; d < snap->ndbs; d++) {
+            path_indexes[kind][d] = load_pathindex(d, kind);
+        }
+    }
+    return path_indexes[kind];
+}
+
+void path_add(const pathindex_t *idx, size_t i, bitset_t *hits) {
+    uint32_t k;
+    for(k = idx->post_start[i]; k < idx->post_start[i + 1]; k++) {
+        uint32_t id = idx->ids[idx->post_ids[k]];
+        if(id != UINT32_MAX) {
+            bitset_set(hits, id);
+        }
+    }
+}
+
+/* the packages owning a path that matches: exact paths and literal
+ * prefixes are looked up, anything else tests every distinct path once
+ * rather than once per package listing it */
+bitset_t *path_hits(pred_t *pred) {
+    pathindex_t **idxs = get_pathindexes(pred->pathkind);
+    const literal_t *lit = pred->lit;
+    pathiter_t it;
+    size_t d;
+
+    pred->hits = bitset_new(snap->count);
+    for(d = 0; d < snap->ndbs; d++) {
+        const pathindex_t *idx = idxs[d];
+
+        if(idx == NULL) {
+            continue;
+        }
+
+        if(pred->type == CMP_EQ) {
+            pathiter_seek(idx, pred->value, strlen(pred->value), 0, &it);
+            if(it.i < idx->npaths && strcmp(it.path, pred->value) == 0) {
+                path_add(idx, it.i, pred->hits);
+            }
+        } else if(pred->type == CMP_RE && lit && (lit->anchor & LIT_START) && !idx->newlines) {
+            for(pathiter_seek(idx, lit->needle, lit->len, 1, &it);
+                    it.i < idx->npaths && strncasecmp(it.path, lit->needle, lit->len) == 0;
+                    pathiter_next(&it)) {
+                if(pred_test_str(pred, it.path, it.len)) {
+                    path_add(idx, it.i, pred->hits);
+                }
+            }
+        } else {
+            for(pathiter_first(idx, &it); it.i < idx->npaths; pathiter_next(&it)) {
+                if(pred_test_str(pred, it.path, it.len)) {
+                    path_add(idx, it.i, pred->hits);
+                }
+            }
+        }
+    }
+
+    return pred->hits;
+}
+
+/* leaves answered from an index rather than by looking at each package */
+bitset_t *get_hits(pred_t *pred) {
+    if(pred->hits) {
+        return pred->hits;
+    }
+    return pred->numcol >= 0 ? num_hits(pred) : path_hits(pred);
+}
+
+/* the packages a regex on an indexed column can match, or NULL if the
+ * trigram index cannot narrow them down */
+bitset_t *get_cand(pred_t *pred) {
+    if(!pred->cand_ready) {
+        if(pred->column >= 0 && pred->list < 0 && pred->gfn == NULL
+                && (pred->type == CMP_RE || pred->type == CMP_NR)) {
+            pred->cand = trigram_candidates(snap, pred->column, pred->value);
+        }
+        pred->cand_ready = 1;
+    }
+    return pred->cand;
+}
+
+int terms_match(termset_t *terms, size_t id) {
+    uint64_t hits = 0;
+    size_t t, f, i, nitems;
+    const snapitem_t *items;
+    const char *str;
+
+    if(terms->acmask) {
+        if((str = snap_str(snap, SCOL_NAME, id))) {
+            hits |= acmatch_scan(terms->ac, str, snap_strlen(snap, SCOL_NAME, id));
+        }
+        if((str = snap_str(snap, SCOL_DESC, id)) && (hits & terms->acmask) != terms->acmask) {
+            hits |= acmatch_scan(terms->ac, str, snap_strlen(snap, SCOL_DESC, id));
+        }
+        items = snap_list(snap, LCOL_PROVIDES, id, &nitems);
+        for(i = 0; i < nitems && (hits & terms->acmask) != terms->acmask; i++) {
+            hits |= acmatch_scan(terms->ac, snap_item_str(snap, id, items[i].str), items[i].len);
+        }
+        items = snap_list(snap, LCOL_GROUP, id, &nitems);
+        for(i = 0; i < nitems && (hits & terms->acmask) != terms->acmask; i++) {
+            hits |= acmatch_scan(terms->ac, snap_item_str(snap, id, items[i].str), items[i].len);
+        }
+        if((hits & terms->acmask) != terms->acmask) {
+            return 0;
+        }
+    }
+
+    for(t = 0; t < terms->count; t++) {
+        int matched = 0;
+        if(terms->acmask & ((uint64_t) 1 << t)) {
+            continue;
+        }
+        for(f = 0; f < TERM_FIELDS && !matched; f++) {
+            matched = pred_match(terms->preds[t * TERM_FIELDS + f], id);
+        }
+        if(!matched) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int pred_match(pred_t *pred, size_t id) {
+    int matched = 0;
+
+    if(pred->terms) {
+        matched = terms_match(pred->terms, id);
+    } else if(pred->next && pred->recursive) {
+        if(pred->closure == NULL) {
+            pred->closure = closure_new(snap->count, all_pkgs);
+        }
+        matched = closure_test(pred->closure, get_pkgs(pred), id,
+                (hit_fn) pred_match, pred->next);
+    } else if(pred->next) {
+        depgraph_t *graph = get_pkgs(pred);
+        uint32_t e;
+        for(e = graph->offsets[id]; e < graph->offsets[id + 1] && !matched; e++) {
+            uint32_t s = graph->edges[e];
+            matched = bitset_test(all_pkgs, s) && pred_match(pred->next, s);
+        }
+    } else if(pred->gfn) {
+        depgraph_t *graph = pred->gfn();
+        uint32_t e;
+        for(e = graph->offsets[id]; e < graph->offsets[id + 1] && !matched; e++) {
+            const char *prop = snap_str(snap, pred->column, graph->edges[e]);
+            matched = prop && pred_test_str(pred, prop,
+                    snap_strlen(snap, pred->column, graph->edges[e]));
+        }
+    } else if(pred->numcol >= 0 || pred->pathkind >= 0) {
+        matched = bitset_test(get_hits(pred), id);
+    } else if(pred->list >= 0) {
+        size_t i, nitems;
+        const snapitem_t *items = snap_list(snap, pred->list, id, &nitems);
+        for(i = 0; i < nitems && !matched; i++) {
+            const char *prop = snap_item_str(snap, id, items[i].str);
+            matched = pred_test_str(pred, prop, items[i].len);
+        }
+    } else {
+        const char *prop = snap_str(snap, pred->column, id);
+        bitset_t *cand = get_cand(pred);
+        if(prop && cand && !bitset_test(cand, id)) {
+            /* the regex cannot match */
+            matched = pred->efn(1);
+        } else {
+            matched = prop && pred_test_str(pred, prop, snap_strlen(snap, pred->column, id));
+        }
+    }
+
+    return matched;
+}
+
+/* tests a query leaf, reusing the result of an identical leaf elsewhere in
+ * the query; tasks own whole words of every bitset, so the memo needs no
+ * locking */
+int leaf_match(pred_t *pred, size_t id) {
+    int matched;
+
+    if(pred->tested == NULL) {
+        return pred_match(pred, id);
+    }
+    if(bitset_test(pred->tested, id)) {
+        return bitset_test(pred->result, id);
+    }
+    bitset_set(pred->tested, id);
+    if((matched = pred_match(pred, id))) {
+        bitset_set(pred->result, id);
+    }
+    return matched;
+}
+
+/* builds everything pred_match would otherwise build lazily, including for
+ * the fields of pacman-style terms; returns 0 if the leaf keeps mutable
+ * state during matching and must run on one thread */
+int pred_prepare(pred_t *pred) {
+    size_t i;
+
+    for(; pred; pred = pred->next) {
+        if(pred->next && pred->recursive) {
+            return 0;
+        }
+        if(pred->terms) {
+            for(i = 0; i < pred->terms->count * TERM_FIELDS; i++) {
+                if(pred->terms->preds[i] && !pred_prepare(pred->terms->preds[i])) {
+                    return 0;
+                }
+            }
+        } else if(pred->next) {
+            get_pkgs(pred);
+        } else if(pred->gfn) {
+            pred->gfn();
+        } else if(pred->numcol >= 0 || pred->pathkind >= 0) {
+            get_hits(pred);
+        } else if(pred->column >= 0) {
+            get_cand(pred);
+        }
+    }
+    return 1;
+}
+
+void filter_task(filter_task_t *task, size_t chunk, size_t w) {
+    size_t first = chunk * FILTER_CHUNK_WORDS * 64;
+    size_t last = first + FILTER_CHUNK_WORDS * 64;
+    size_t id;
+
+    worker = w;
+    if(last > task->pkgs->nbits) {
+        last = task->pkgs->nbits;
+    }
+
+    /* tasks own whole words of the result, so no two threads write the
+     * same word */
+    for(id = bitset_next(task->pkgs, first); id < last; id = bitset_next(task->pkgs, id + 1)) {
+        if(leaf_match(task->pred, id)) {
+            bitset_set(task->ret, id);
+        }
+    }
+}
+
+bitset_t *filter_pkgs(node_t *cmp, bitset_t *pkgs) {
+    bitset_t *ret, *scan = NULL;
+    size_t id;
+
+    if(cmp->pred->numcol >= 0 || cmp->pred->pathkind >= 0) {
+        ret = bitset_copy(get_hits(cmp->pred));
+        bitset_and(ret, pkgs);
+        return ret;
+    }
+
+    /* only the trigram candidates can match a regex */
+    if(cmp->pred->type == CMP_RE && get_cand(cmp->pred)) {
+        scan = bitset_copy(cmp->pred->cand);
+        bitset_and(scan, pkgs);
+    }
+
+    ret = bitset_new(pkgs->nbits);
+    if(pool && pkgs->nwords > FILTER_CHUNK_WORDS && pred_prepare(cmp->pred)) {
+        filter_task_t task = { cmp->pred, scan ? scan : pkgs, ret };
+        size_t ntasks = (pkgs->nwords + FILTER_CHUNK_WORDS - 1) / FILTER_CHUNK_WORDS;
+        pool_run(pool, ntasks, (task_fn) filter_task, &task);
+        bitset_free(scan);
+        return ret;
+    }
+
+    if(scan) {
+        pkgs = scan;
+    }
+    for(id = bitset_first(pkgs); id < pkgs->nbits; id = bitset_next(pkgs, id + 1)) {
+        if(leaf_match(cmp->pred, id)) {
+            bitset_set(ret, id);
+        }
+    }
+
+    bitset_free(scan);
+    return ret;
+}
+
+bitset_t *run_query(node_t *query, bitset_t *pkgs) {
+    if( query == NULL ) {
+        return bitset_copy(pkgs);
+    }
+
+    bitset_t *left;
+    bitset_t *right;
+    bitset_t *rest;
+
+    switch(query->type) {
+        case OP_AND:
+            left = run_query(query->left, pkgs);
+            right = run_query(query->right, left);
+            bitset_free(left);
+            return right;
+            break;
+        case OP_OR:
+            /* the right side only needs to decide packages the left side
+             * rejected */
+            left = run_query(query->left, pkgs);
+            rest = bitset_copy(pkgs);
+            bitset_andnot(rest, left);
+            right = run_query(query->right, rest);
+            bitset_or(left, right);
+            bitset_free(right);
+            bitset_free(rest);
+            return left;
+            break;
+        case OP_XOR:
+            left = run_query(query->left, pkgs);
+            right = run_query(query->right, pkgs);
+            bitset_xor(left, right);
+            bitset_free(right);
+            return left;
+            break;
+        case OP_NOT:
+            left = run_query(query->left, pkgs);
+            right = bitset_copy(pkgs);
+            bitset_andnot(right, left);
+            bitset_free(left);
+            return right;
+            break;
+        default:
+            break;
+    }
+
+    return filter_pkgs(query, pkgs);
+}
+
+size_t program_emit(program_t *prog, opcode_t op, pred_t *pred) {
+    insn_t *insn;
+
+    if(prog->len == prog->size) {
+        prog->size *= 2;
+        prog->code = realloc(prog->code, prog->size * sizeof(insn_t));
+    }
+    insn = prog->code + prog->len;
+    insn->op = op;
+    insn->target = 0;
+    insn->pred = pred;
+    return prog->len++;
+}
+
+void program_build(program_t *prog, node_t *node, size_t depth) {
+    size_t jump;
+
+    if(depth > prog->depth) {
+        prog->depth = depth;
+    }
+
+    if(node == NULL) {
+        program_emit(prog, OPC_TRUE, NULL);
+        return;
+    }
+
+    switch(node->type) {
+        case OP_AND:
+        case OP_OR:
+            program_build(prog, node->left, depth);
+            jump = program_emit(prog, node->type == OP_AND ? OPC_JZ : OPC_JNZ, NULL);
+            program_build(prog, node->right, depth);
+            prog->code[jump].target = prog->len;
+            break;
+        case OP_XOR:
+            program_build(prog, node->left, depth);
+            program_emit(prog, OPC_PUSH, NULL);
+            program_build(prog, node->right, depth + 1);
+            program_emit(prog, OPC_XOR, NULL);
+            break;
+        case OP_NOT:
+            program_build(prog, node->left, depth);
+            program_emit(prog, OPC_NOT, NULL);
+            break;
+        default:
+            program_emit(prog, OPC_LEAF, node->pred);
+            if(!pred_prepare(node->pred)) {
+                prog->parallel = 0;
+            }
+            break;
+    }
+}
+
+program_t *program_compile(node_t *query) {
+    program_t *prog = calloc(1, sizeof(program_t));
+
+    prog->size = 16;
+    prog->code = malloc(prog->size * sizeof(insn_t));
+    prog->parallel = 1;
+    program_build(prog, query, 0);
+
+    return prog;
+}
+
+void program_free(program_t *prog) {
+    if(prog == NULL) {
+        return;
+    }
+    free(prog->code);
+    free(prog);
+}
+
+/* jumps only skip forward past the right side of an -and/-or whose value
+ * is already decided, leaving the accumulator as the result */
+int program_run(program_t *prog, size_t id, int *stack) {
+    size_t pc = 0, sp = 0;
+    int acc = 0;
+
+    while(pc < prog->len) {
+        const insn_t *insn = prog->code + pc++;
+
+        switch(insn->op) {
+            case OPC_LEAF:
+                acc = leaf_match(insn->pred, id);
+                break;
+            case OPC_TRUE:
+                acc = 1;
+                break;
+            case OPC_JZ:
+                if(!acc) {
+                    pc = insn->target;
+                }
+                break;
+            case OPC_JNZ:
+                if(acc) {
+                    pc = insn->target;
+                }
+                break;
+            case OPC_NOT:
+                acc = !acc;
+                break;
+            case OPC_PUSH:
+                stack[sp++] = acc;
+                break;
+            case OPC_XOR:
+                acc = stack[--sp] != acc;
+                break;
+        }
+    }
 
-    if(config.depends) {
-        alpm_list_t *p;
-        for(p = all_pkgs; p; p = alpm_list_next(p)) {
-            if(alpm_pkg_get_reason(p->data) != ALPM_PKG_REASON_DEPEND) {
-                all_pkgs = alpm_list_remove_item(all_pkgs, p);
+    return acc;
+}
+
+void program_task(program_task_t *task, size_t batch, size_t w) {
+    size_t first = (task->first + batch) * PROGRAM_BATCH_WORDS * 64;
+    size_t last = first + PROGRAM_BATCH_WORDS * 64;
+    int *stack = malloc((task->prog->depth + 1) * sizeof(int));
+    size_t id, found = 0;
+
+    worker = w;
+    if(last > task->pkgs->nbits) {
+        last = task->pkgs->nbits;
+    }
+
+    for(id = bitset_next(task->pkgs, first); id < last; id = bitset_next(task->pkgs, id + 1)) {
+        if(program_run(task->prog, id, stack)) {
+            bitset_set(task->ret, id);
+            if(++found == task->stop) {
+                break;
             }
         }
     }
 
-    if(config.explicit) {
-        alpm_list_t *p;
-        for(p = all_pkgs; p; p = alpm_list_next(p)) {
-            if(alpm_pkg_get_reason(p->data) != ALPM_PKG_REASON_EXPLICIT) {
-                all_pkgs = alpm_list_remove_item(all_pkgs, p);
+    free(stack);
+}
+
+/* streams the packages through the query a round of batches at a time and
+ * prints the matches of each round as soon as it is done, in package order;
+ * with a limit evaluation stops once that many packages have been printed.
+ * Returns the printed packages */
+bitset_t *run_program(program_t *prog, bitset_t *pkgs, config_t *config) {
+    program_task_t task = { prog, pkgs, bitset_new(pkgs->nbits), 0, 0 };
+    size_t batches = (pkgs->nwords + PROGRAM_BATCH_WORDS - 1) / PROGRAM_BATCH_WORDS;
+    size_t round = 1, printed = 0, n, id, last;
+
+    if(pool && prog->parallel && batches > 1) {
+        round = nworkers * 2;
+    }
+
+    for(task.first = 0; task.first < batches; task.first += n) {
+        n = batches - task.first < round ? batches - task.first : round;
+        /* no batch can contribute more than what is left to print */
+        task.stop = config->limit ? config->limit - printed : 0;
+        if(n > 1) {
+            pool_run(pool, n, (task_fn) program_task, &task);
+        } else {
+            program_task(&task, 0, 0);
+        }
+
+        last = (task.first + n) * PROGRAM_BATCH_WORDS * 64;
+        if(last > pkgs->nbits) {
+            last = pkgs->nbits;
+        }
+        for(id = bitset_next(task.ret, task.first * PROGRAM_BATCH_WORDS * 64);
+                id < last; id = bitset_next(task.ret, id + 1)) {
+            if(config->limit && printed == config->limit) {
+                bitset_unset(task.ret, id);
+            } else {
+                print_pkg(id, config);
+                printed++;
             }
         }
+        if((config->limit && printed == config->limit) || out_error()) {
+            break;
+        }
+    }
+
+    return task.ret;
+}
+
+int dbsnap_key(alpm_handle_t *handle, alpm_db_t *alpmdb, cachekey_t *key) {
+    const char *dbpath = alpm_option_get_dbpath(handle);
+
+    if(alpmdb == alpm_get_localdb(handle)) {
+        return cache_key_local(dbpath, key);
+    }
+    return cache_key_sync(dbpath, alpm_db_get_name(alpmdb), key);
+}
+
+/* the native reader does not check signatures, so a sync database is left
+ * to libalpm whenever libalpm would check its signature */
+char *native_path(const char *dbname, int local, config_t *config) {
+    const confrepo_t *repo = conf_repo(conf, dbname);
+    alpm_siglevel_t level = repo ? repo->siglevel : conf->siglevel;
+    char path[4096], sig[4096 + 4];
+
+    if(config->reader != READER_NATIVE) {
+        return NULL;
+    }
+    if(local) {
+        snprintf(path, sizeof(path), "%s/local", alpm_option_get_dbpath(handle));
+        return strdup(path);
+    }
+    snprintf(path, sizeof(path), "%s/sync/%s.db", alpm_option_get_dbpath(handle), dbname);
+    snprintf(sig, sizeof(sig), "%s.sig", path);
+    if((level & ALPM_SIG_DATABASE) && (!(level & ALPM_SIG_DATABASE_OPTIONAL)
+                || access(sig, F_OK) == 0)) {
+        return NULL;
+    }
+    return strdup(path);
+}
+
+/* reads a database, refreshing its cache if it has a key; an archive the
+ * native reader cannot read is left for libalpm */
+void dbload_task(dbload_t **todo, size_t task, size_t worker) {
+    dbload_t *load = todo[task];
+    (void) worker;
+
+    if(load->path && load->local) {
+        load->db = localdb_read(load->path, load->pool);
+    } else if(load->path) {
+        load->db = syncdb_read(load->path, alpm_db_get_name(load->alpmdb));
+    } else {
+        load->db = dbsnap_from_alpm(load->alpmdb, load->local);
+    }
+    if(load->db && load->keyed) {
+        trigram_build(load->db);
+        cache_save(load->db, &load->key);
+    }
+}
+
+/* fills in the databases missing from dbs: from the cache if the database
+ * has not changed since the cache was written, otherwise from the database
+ * itself.  Reading a sync database means decompressing and parsing all of
+ * it, so when several have to be read they are read on the worker threads.
+ * The local database is one directory per package, whose files are read on
+ * the worker threads before the sync databases */
+void load_dbsnaps(alpm_db_t **alpmdbs, dbsnap_t **dbs, size_t ndbs, config_t *config) {
+    dbload_t *loads = calloc(ndbs ? ndbs : 1, sizeof(dbload_t));
+    dbload_t **todo = malloc((ndbs ? ndbs : 1) * sizeof(dbload_t*));
+    size_t d, ntodo = 0, nsync;
+
+    for(d = 0; d < ndbs; d++) {
+        dbload_t *load = loads + d;
+
+        if(dbs[d]) {
+            continue;
+        }
+        load->alpmdb = alpmdbs[d];
+        load->local = alpmdbs[d] == alpm_get_localdb(handle);
+        load->keyed = !config->nocache && dbsnap_key(handle, alpmdbs[d], &load->key) == 0;
+        if(load->keyed && (dbs[d] = cache_load(alpm_db_get_name(alpmdbs[d]), load->local, &load->key))) {
+            continue;
+        }
+        load->path = native_path(alpm_db_get_name(alpmdbs[d]), load->local, config);
+        todo[ntodo++] = load;
+    }
+
+    /* the local database goes last and is read by itself */
+    nsync = ntodo;
+    for(d = 0; d < ntodo; d++) {
+        if(todo[d]->local && todo[d]->path) {
+            dbload_t *local = todo[d];
+            todo[d] = todo[ntodo - 1];
+            todo[ntodo - 1] = local;
+            local->pool = pool;
+            dbload_task(todo, ntodo - 1, 0);
+            nsync--;
+            break;
+        }
     }
 
-    if(config.unneeded) {
-        alpm_list_t *p;
-        for(p = all_pkgs; p; p = alpm_list_next(p)) {
-            alpm_list_t *r = alpm_pkg_compute_requiredby(p->data);
-            if(r) {
-                all_pkgs = alpm_list_remove_item(all_pkgs, p);
-                FREELIST(r);
+    if(pool && nsync > 1) {
+        for(d = 0; d < nsync; d++) {
+            alpm_db_t *alpmdb;
+            if(todo[d]->local || todo[d]->path) {
+                continue;
+            }
+            todo[d]->handle = syncdb_handle(alpm_db_get_name(todo[d]->alpmdb), NULL, &alpmdb);
+            if(alpmdb) {
+                todo[d]->alpmdb = alpmdb;
             }
         }
+        pool_run(pool, nsync, (task_fn) dbload_task, todo);
+    } else {
+        for(d = 0; d < nsync; d++) {
+            dbload_task(todo, d, 0);
+        }
     }
 
-    if(config.foreign) {
-        alpm_list_t *p, *dbs = alpm_get_syncdbs(handle);
-        for(; dbs; dbs = alpm_list_next(dbs)) {
-            for(p = all_pkgs; p; p = alpm_list_next(p)) {
-                if(alpm_db_get_pkg(dbs->data, alpm_pkg_get_name(p->data))) {
-                    all_pkgs = alpm_list_remove_item(all_pkgs, p);
+    for(d = 0; d < ntodo; d++) {
+        if(todo[d]->db == NULL) {
+            free(todo[d]->path);
+            todo[d]->path = NULL;
+            dbload_task(todo, d, 0);
+        }
+    }
+
+    for(d = 0; d < ndbs; d++) {
+        if(loads[d].db) {
+            dbs[d] = loads[d].db;
+        }
+        if(loads[d].handle) {
+            alpm_release(loads[d].handle);
+        }
+        free(loads[d].path);
+    }
+    free(todo);
+    free(loads);
+}
+
+dbsnap_t *find_resident(alpm_handle_t *handle, alpm_db_t *alpmdb) {
+    const char *dbname = alpm_db_get_name(alpmdb);
+    int local = alpmdb == alpm_get_localdb(handle);
+    size_t r;
+
+    for(r = 0; r < nresident; r++) {
+        if(resident[r].db->local == local && strcmp(resident[r].db->dbname, dbname) == 0) {
+            return resident[r].db;
+        }
+    }
+    return NULL;
+}
+
+/* repositories are registered with the handle the first time a query
+ * needs them */
+alpm_db_t *get_syncdb(const confrepo_t *repo) {
+    alpm_list_t *d;
+    alpm_db_t *db;
+
+    for(d = alpm_get_syncdbs(handle); d; d = alpm_list_next(d)) {
+        if(strcmp(alpm_db_get_name(d->data), repo->name) == 0) {
+            return d->data;
+        }
+    }
+    if((db = alpm_register_syncdb(handle, repo->name, repo->siglevel)) == NULL) {
+        fprintf(stderr, "warning: could not register repository '%s': %s\n",
+                repo->name, alpm_strerror(alpm_errno(handle)));
+        return NULL;
+    }
+    alpm_db_set_usage(db, repo->usage);
+    return db;
+}
+
+/* without --repo the repositories pacman.conf allows searching are
+ * searched, as with pacman -Ss */
+int repo_searched(config_t *config, const char *name, int usage) {
+    if(config->repos) {
+        return alpm_list_find_str(config->repos, name) != NULL;
+    }
+    return (usage & ALPM_DB_USAGE_SEARCH) != 0;
+}
+
+bitset_t *build_pkg_list(alpm_handle_t *handle, config_t *config, nameset_t *names) {
+    bitset_t *pkgs;
+    alpm_db_t **alpmdbs, *alpmdb;
+    dbsnap_t **dbs;
+    size_t ndbs = 0, searched, r;
+
+    alpmdbs = malloc((2 * conf->nrepos + 1) * sizeof(alpm_db_t*));
+    if(config->sync && !(config->depends || config->explicit || config->unneeded || config->foreign)) {
+        for(r = 0; r < conf->nrepos; r++) {
+            if(repo_searched(config, conf->repos[r].name, conf->repos[r].usage)
+                    && (alpmdb = get_syncdb(conf->repos + r))) {
+                alpmdbs[ndbs++] = alpmdb;
+            }
+        }
+    }
+    if(config->local && repo_searched(config, "local", ALPM_DB_USAGE_SEARCH)) {
+        alpmdbs[ndbs++] = alpm_get_localdb(handle);
+    }
+
+    /* foreign packages are found by looking their names up in the sync
+     * databases, so every one of them is loaded even though none is
+     * searched */
+    searched = ndbs;
+    if(config->foreign) {
+        for(r = 0; r < conf->nrepos; r++) {
+            if((alpmdb = get_syncdb(conf->repos + r))) {
+                alpmdbs[ndbs++] = alpmdb;
+            }
+        }
+    }
+
+    dbs = malloc((ndbs ? ndbs : 1) * sizeof(dbsnap_t*));
+    for(r = 0; r < ndbs; r++) {
+        dbs[r] = find_resident(handle, alpmdbs[r]);
+    }
+    load_dbsnaps(alpmdbs, dbs, ndbs, config);
+    snap = snapshot_new(dbs, ndbs);
+    free(dbs);
+    free(alpmdbs);
+
+    pkgs = bitset_new(snap->count);
+
+    for(ndbs = 0; ndbs < searched; ndbs++) {
+        const char *dbname = snap->dbs[ndbs]->dbname;
+        size_t first = snap->base[ndbs], last = first + snap->dbs[ndbs]->count;
+        size_t id;
+
+        for(id = first; id < last; id++) {
+            if(names == NULL || nameset_has(names, dbname,
+                        snap_str(snap, SCOL_NAME, id), snap_strlen(snap, SCOL_NAME, id))) {
+                bitset_set(pkgs, id);
+            }
+        }
+    }
+
+    return pkgs;
+}
+
+void dump_pkg_short(size_t id, int verbosity) {
+    if(verbosity < 0) {
+        out_write(snap_str(snap, SCOL_NAME, id), snap_strlen(snap, SCOL_NAME, id));
+        out_char('\n');
+    } else {
+        size_t i, ngroups;
+        const snapitem_t *groups = snap_list(snap, LCOL_GROUP, id, &ngroups);
+        out_str(palette.repo);
+        out_str(snap_dbname(snap, id));
+        out_str(palette.base);
+        out_char('/');
+        out_str(palette.pkgname);
+        out_str(snap_str(snap, SCOL_NAME, id));
+        out_char(' ');
+        out_str(palette.pkgver);
+        out_str(snap_str(snap, SCOL_VERSION, id));
+        out_str(palette.base);
+        if(ngroups) {
+            out_str(palette.groups);
+            out_str(" (");
+            for(i = 0; i < ngroups; i++) {
+                out_str(snap_item_str(snap, id, groups[i].str));
+                if(i + 1 < ngroups) {
+                    out_str(", ");
                 }
             }
+            out_char(')');
+            out_str(palette.base);
+        }
+
+        out_str("\n    ");
+        out_str(snap_str(snap, SCOL_DESC, id));
+        out_char('\n');
+    }
+}
+
+void dump_pkg_full(size_t id) {
+    if(info_format == NULL) {
+        info_format = format_info();
+    }
+    format_pkg(info_format, snap, id);
+}
+
+void print_pkg(size_t id, config_t *config) {
+    int verbosity = config ? config->info_level - config->quiet : 0;
+
+    if(format) {
+        format_pkg(format, snap, id);
+    } else if(config && config->info_level) {
+        dump_pkg_full(id);
+    } else {
+        dump_pkg_short(id, verbosity);
+    }
+}
+
+void print_pkgs(bitset_t *pkgs, config_t *config) {
+    size_t limit = config ? config->limit : 0;
+    size_t id, printed = 0;
+
+    for(id = bitset_first(pkgs); id < pkgs->nbits; id = bitset_next(pkgs, id + 1)) {
+        if(limit && printed++ == limit) {
+            break;
         }
+        print_pkg(id, config);
     }
+}
+
+/* evaluates a compiled query over all_pkgs and prints the matches */
+void search(node_t *query, config_t *config) {
+    bitset_t *matched = NULL;
 
-    if(query) {
+    if(format) {
+        format_begin(format);
+    }
+    if(query && config->eval == EVAL_STREAM) {
+        program_t *prog = program_compile(query);
+        matched = run_program(prog, all_pkgs, config);
+        program_free(prog);
+    } else if(query) {
         matched = run_query(query, all_pkgs);
+        print_pkgs(matched, config);
+    } else {
+        print_pkgs(all_pkgs, config);
+    }
+    if(format) {
+        format_end(format);
+    }
+    bitset_free(matched);
+}
+
+/* splits a line into words in place: blanks separate words, quotes group
+ * them and a backslash escapes the next character, as in the shell */
+int split_words(char *line, int *argc, char ***argv) {
+    size_t size = 8;
+    char *in = line, *out = line;
+
+    *argc = 0;
+    *argv = malloc(size * sizeof(char*));
+
+    for(;;) {
+        char quote = 0;
+
+        while(isspace((unsigned char) *in)) {
+            in++;
+        }
+        if(*in == '\0') {
+            break;
+        }
+
+        if((size_t) *argc + 1 == size) {
+            size *= 2;
+            *argv = realloc(*argv, size * sizeof(char*));
+        }
+        (*argv)[(*argc)++] = out;
+
+        for(; *in && (quote || !isspace((unsigned char) *in)); in++) {
+            if(*in == quote) {
+                quote = 0;
+            } else if(!quote && (*in == '\'' || *in == '"')) {
+                quote = *in;
+            } else if(*in == '\\' && quote != '\'' && in[1]) {
+                *out++ = *++in;
+            } else {
+                *out++ = *in;
+            }
+        }
+        if(quote) {
+            free(*argv);
+            return -1;
+        }
+        if(*in) {
+            in++;
+        }
+        *out++ = '\0';
+    }
+
+    (*argv)[*argc] = NULL;
+    return 0;
+}
+
+/* reads all of path ('-' for standard input), so that it can be sent to
+ * the daemon; returns NULL after printing an error */
+char *batch_read(const char *path) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    size_t len = 0, size = 4096, n;
+    char *text;
+
+    if(fp == NULL) {
+        fprintf(stderr, "error: could not open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    text = malloc(size);
+    while((n = fread(text + len, 1, size - len - 1, fp)) > 0) {
+        len += n;
+        if(size - len == 1) {
+            size *= 2;
+            text = realloc(text, size);
+        }
+    }
+    if(ferror(fp)) {
+        fprintf(stderr, "error: could not read %s: %s\n", path, strerror(errno));
+        free(text);
+        text = NULL;
+    } else {
+        text[len] = '\0';
+    }
+    if(fp != stdin) {
+        fclose(fp);
+    }
+    return text;
+}
+
+/* runs one query per line of path ('-' for standard input), or of
+ * batch_text if it was already read, over the packages selected once by the
+ * options; leaves are shared across the whole batch, so a leaf repeated by
+ * later queries is only tested for packages it has not seen yet */
+int run_batch(const char *path, config_t *config) {
+    FILE *fp = batch_text ? fmemopen((char*) batch_text, strlen(batch_text), "r")
+        : strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    char *line = NULL;
+    size_t size = 0, count = 0;
+    int status = 0;
+
+    if(fp == NULL) {
+        fprintf(stderr, "error: could not open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    leaf_cache = calloc(1, sizeof(leaftab_t));
+    leaf_cache->keep = 1;
+    if(config->json) {
+        out_char('[');
+    }
+
+    while(getline(&line, &size, fp) != -1) {
+        size_t len = strtrim(line);
+        char *words, **argv;
+        int argc, i = 0;
+        node_t *query;
+
+        if(len == 0 || line[0] == '#') {
+            continue;
+        }
+
+        words = strdup(line);
+        if(split_words(words, &argc, &argv) != 0) {
+            fprintf(stderr, "error: unterminated quote: %s\n", line);
+            free(words);
+            status = 1;
+            continue;
+        }
+        query = parse_query(argc, argv, &i);
+        free(argv);
+        free(words);
+
+        /* compile errors are printed with stdio */
+        out_flush();
+        if(compile_query(query) != 0) {
+            fflush(stdout);
+            node_free(query);
+            status = 1;
+            continue;
+        }
+        query = optimize_query(query);
+        share_leaves(query);
+
+        if(config->json) {
+            out_str(count ? ",\n{\"query\":\"" : "\n{\"query\":\"");
+            format_json_escape(line, len);
+            out_str("\",\"packages\":");
+        } else {
+            out_str(":: ");
+            out_write(line, len);
+            out_char(config->nul ? '\0' : '\n');
+        }
+        search(query, config);
+        if(config->json) {
+            out_char('}');
+        }
+        count++;
+
+        node_free(query);
+        if(out_error()) {
+            break;
+        }
+    }
+
+    if(config->json) {
+        out_str("\n]\n");
+    }
+    free(line);
+    if(fp != stdin) {
+        fclose(fp);
+    }
+    return status;
+}
+
+/* rereads the databases whose cache key changed since they were loaded;
+ * libalpm keeps what it has read, so that takes a new handle.  pacman.conf
+ * is read again too, in case repositories were added or removed */
+void serve_refresh(void *ctx) {
+    config_t *config = ctx;
+    resident_t *old = resident;
+    size_t nold = nresident, d, r;
+    alpm_handle_t *newhandle;
+    alpm_db_t **alpmdbs;
+    dbsnap_t **dbs;
+    conf_t *newconf;
+
+    /* keep answering from what is loaded if the new setup is unusable */
+    if((newconf = conf_load(config->config_file ? config->config_file : CONF_FILE)) == NULL) {
+        return;
+    }
+    if((newhandle = alpm_initialize(newconf->rootdir, newconf->dbpath, NULL)) == NULL) {
+        conf_free(newconf);
+        return;
+    }
+    alpm_release(handle);
+    conf_free(conf);
+    handle = newhandle;
+    conf = newconf;
+
+    alpmdbs = malloc((conf->nrepos + 1) * sizeof(alpm_db_t*));
+    nresident = 0;
+    for(r = 0; r < conf->nrepos; r++) {
+        if((alpmdbs[nresident] = get_syncdb(conf->repos + r))) {
+            nresident++;
+        }
+    }
+    alpmdbs[nresident++] = alpm_get_localdb(handle);
+
+    resident = calloc(nresident, sizeof(resident_t));
+    dbs = calloc(nresident, sizeof(dbsnap_t*));
+    for(d = 0; d < nresident; d++) {
+        resident_t *res = resident + d;
+        const char *dbname = alpm_db_get_name(alpmdbs[d]);
+        int local = alpmdbs[d] == alpm_get_localdb(handle);
+
+        res->keyed = dbsnap_key(handle, alpmdbs[d], &res->key) == 0;
+        for(r = 0; r < nold; r++) {
+            if(old[r].db && old[r].keyed && res->keyed
+                    && old[r].db->local == local && strcmp(old[r].db->dbname, dbname) == 0
+                    && memcmp(&old[r].key, &res->key, sizeof(cachekey_t)) == 0) {
+                dbs[d] = old[r].db;
+                old[r].db = NULL;
+                break;
+            }
+        }
+    }
+    load_dbsnaps(alpmdbs, dbs, nresident, config);
+    for(d = 0; d < nresident; d++) {
+        resident[d].db = dbs[d];
+    }
+
+    for(r = 0; r < nold; r++) {
+        dbsnap_free(old[r].db);
+    }
+    free(old);
+    free(dbs);
+    free(alpmdbs);
+}
+
+int pacfind(int argc, char **argv, nameset_t *names);
+
+int serve_query(void *ctx, int argc, char **argv, const char *batch, nameset_t *names) {
+    (void) ctx;
+    /* the daemon's worker threads were not forked along with it */
+    pool = NULL;
+    nworkers = 1;
+    serving = 1;
+    batch_text = batch;
+    optind = 0;
+    return pacfind(argc, argv, names);
+}
+
+int serve(config_t *config) {
+    char path[4096], dbpath[4096];
+
+    if(config->socket) {
+        snprintf(path, sizeof(path), "%s", config->socket);
+    } else if(daemon_socket_path(path, sizeof(path)) != 0) {
+        fprintf(stderr, "error: no socket path, use --socket\n");
+        return 1;
+    }
+
+    nocache = config->nocache;
+    if(config->jobs != 1) {
+        pool = pool_new(config->jobs ? config->jobs : sysconf(_SC_NPROCESSORS_ONLN));
+        nworkers = pool->nthreads;
+    }
+    serve_refresh(config);
+    if(conf == NULL) {
+        return 1;
+    }
+    /* the handle is replaced on every refresh */
+    snprintf(dbpath, sizeof(dbpath), "%s", alpm_option_get_dbpath(handle));
+    daemon_serve(path, dbpath, serve_query, serve_refresh, config);
+    fprintf(stderr, "error: could not serve queries on %s: %s\n", path, strerror(errno));
+    return 1;
+}
+
+int pacfind(int argc, char **argv, nameset_t *names) {
+    config_t config = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, REGEX_ENGINE_DEFAULT };
+    config.local = 1;
+    config.sync = 1;
+    node_t *query;
+    alpm_list_t *r;
+    alpm_errno_t err;
+    int i, status = 0;
+    size_t id;
+
+    i = parse_opts(argc, argv, &config);
+    /* a batch read from standard input leaves no package names there */
+    if(!serving && !isatty(fileno(stdin))
+            && !(config.batch && strcmp(config.batch, "-") == 0)) {
+        names = nameset_read(stdin);
+    }
+    /* the daemon would answer from the databases it loaded its own way */
+    if(config.remote && !serving && !config.loadopts) {
+        char path[4096];
+        int status = -1;
+        /* the daemon can neither see this process's standard input nor
+         * resolve a path relative to its working directory */
+        if(config.batch && (batch_text = batch_read(config.batch)) == NULL) {
+            return 1;
+        }
+        if(config.socket) {
+            status = daemon_query(config.socket, argc, argv, batch_text, names);
+        } else if(daemon_socket_path(path, sizeof(path)) == 0) {
+            status = daemon_query(path, argc, argv, batch_text, names);
+        }
+        /* without a daemon the query is simply run here */
+        if(status >= 0) {
+            return status;
+        }
+    }
+    if(config.daemon && !serving) {
+        return serve(&config);
+    }
+    if((rxengine = rx_engine(config.regex_engine)) == NULL) {
+        usage("unknown or unsupported regex engine");
+    }
+    if(config.json && (config.format || config.nul)) {
+        usage("--json cannot be combined with --format or -0");
+    } else if(config.json) {
+        format = format_json();
+    } else if(config.format || config.nul) {
+        const char *err;
+        if((format = format_compile(config.format ? config.format : "%n", config.nul, &err)) == NULL) {
+            usage(err);
+        }
+    }
+    if(config.jobs == 0) {
+        config.jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(config.jobs > 1) {
+        pool = pool_new(config.jobs);
+        nworkers = pool->nthreads;
+    }
+    nocache = config.nocache;
+    if(handle == NULL) {
+        if((conf = conf_load(config.config_file ? config.config_file : CONF_FILE)) == NULL) {
+            pool_free(pool);
+            return 1;
+        }
+        if((handle = alpm_initialize(conf->rootdir, conf->dbpath, &err)) == NULL) {
+            fprintf(stderr, "error: could not initialize libalpm: %s\n", alpm_strerror(err));
+            conf_free(conf);
+            pool_free(pool);
+            return 1;
+        }
+    }
+    for(r = config.repos; r; r = alpm_list_next(r)) {
+        if(strcmp(r->data, "local") != 0 && conf_repo(conf, r->data) == NULL) {
+            fprintf(stderr, "error: repository '%s' not found\n", (char*) r->data);
+            conf_free(conf);
+            pool_free(pool);
+            alpm_release(handle);
+            return 1;
+        }
+    }
+    query = parse_query(argc, argv, &i);
+    if(config.batch && query) {
+        usage("--batch cannot be combined with a query");
+    }
+    if(compile_query(query) != 0) {
         node_free(query);
-        print_pkgs(matched, &config);
+        conf_free(conf);
+        pool_free(pool);
+        alpm_release(handle);
+        return 1;
+    }
+    query = optimize_query(query);
+    all_pkgs = build_pkg_list(handle, &config, names);
+
+    if(config.foreign) {
+        bitset_t *sync_pkgs = bitset_new(snap->count);
+        satindex_t *sync_names;
+        for(id = 0; id < snap->count; id++) {
+            if(!snap_local(snap, id)) {
+                bitset_set(sync_pkgs, id);
+            }
+        }
+        sync_names = satindex_new(snap, sync_pkgs);
+        for(id = bitset_first(all_pkgs); id < snap->count; id = bitset_next(all_pkgs, id + 1)) {
+            if(satindex_find_pkg(sync_names, snap_str(snap, SCOL_NAME, id)) >= 0) {
+                bitset_unset(all_pkgs, id);
+            }
+        }
+        satindex_free(sync_names);
+        bitset_free(sync_pkgs);
+    }
+
+    for(id = bitset_first(all_pkgs); id < snap->count; id = bitset_next(all_pkgs, id + 1)) {
+        int64_t reason = snap_num(snap, NCOL_REASON, id);
+
+        if(config.depends && reason != ALPM_PKG_REASON_DEPEND) {
+            bitset_unset(all_pkgs, id);
+        }
+
+        if(config.explicit && reason != ALPM_PKG_REASON_EXPLICIT) {
+            bitset_unset(all_pkgs, id);
+        }
+
+        if(config.unneeded) {
+            depgraph_t *graph = get_requiredby_graph();
+            if(graph->offsets[id + 1] > graph->offsets[id]) {
+                bitset_unset(all_pkgs, id);
+            }
+        }
+    }
+
+    if(config.batch) {
+        status = run_batch(config.batch, &config);
     } else {
-        print_pkgs(all_pkgs, &config);
+        share_leaves(query);
+        search(query, &config);
+        node_free(query);
     }
 
-    alpm_list_free(all_pkgs);
-    alpm_list_free(matched);
+    satindex_free(satisfiers);
+    depgraph_free(depends_graph);
+    depgraph_free(requiredby_graph);
+    for(i = 0; i < LCOL_COUNT; i++) {
+        depgraph_free(list_graphs[i]);
+    }
+    for(i = 0; i < NCOL_COUNT; i++) {
+        numindex_free(num_indexes[i]);
+    }
+    for(i = 0; i < 2; i++) {
+        size_t d;
+        for(d = 0; path_indexes[i] && d < snap->ndbs; d++) {
+            pathindex_free(path_indexes[i][d]);
+        }
+        free(path_indexes[i]);
+    }
+    leaftab_free(leaf_cache);
+    nameset_free(names);
+    format_free(format);
+    format_free(info_format);
+    bitset_free(all_pkgs);
+    snapshot_free(snap);
+    pool_free(pool);
 
     alpm_release(handle);
+    conf_free(conf);
+    FREELIST(config.repos);
 
-    return 0;
+    out_flush();
+    return out_error() ? 1 : status;
+}
+
+int main(int argc, char **argv) {
+    return pacfind(argc, argv, NULL);
 }
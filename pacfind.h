@@ -68,6 +68,9 @@ static field_map_t field_map[] = {
     {"isize", ISIZE},
     {"base64sig", BASE64SIG},
 
+    {"files", FILES},
+    {"backup", BACKUP},
+
     {NULL, 0}
 };
 
@@ -81,14 +84,84 @@ typedef struct config_t {
     int local;
     int foreign;
     int upgrades;
+    int nocache;
+    long jobs;
+    const char *regex_engine;
+    int eval;
+    size_t limit;
+    const char *format;
+    int json;
+    int nul;
+    int daemon;
+    int remote;
+    const char *socket;
+    const char *batch;
+    const char *config_file;
+    alpm_list_t *repos;
+    int reader;
+    /* set by --config, --nocache and --reader, which choose how databases
+     * are loaded; a daemon's databases are already loaded */
+    int loadopts;
 } config_t;
 
+/* how a query is executed: one package at a time through the whole query,
+ * or one leaf at a time over the whole package set */
+typedef enum eval_t {
+    EVAL_STREAM,
+    EVAL_SETS
+} eval_t;
+
+/* how databases missing from the cache are read */
+typedef enum reader_t {
+    READER_NATIVE,
+    READER_ALPM
+} reader_t;
+
+enum {
+    OPT_NOCACHE = 1000,
+    OPT_REGEX_ENGINE,
+    OPT_EVAL,
+    OPT_LIMIT,
+    OPT_FORMAT,
+    OPT_JSON,
+    OPT_DAEMON,
+    OPT_REMOTE,
+    OPT_SOCKET,
+    OPT_BATCH,
+    OPT_CONFIG,
+    OPT_READER
+};
+
+/* a database kept loaded by --daemon and the cache key it was read with */
+typedef struct resident_t {
+    dbsnap_t *db;
+    cachekey_t key;
+    int keyed;
+} resident_t;
+
+/* a database being read, from path by the native reader or through
+ * libalpm; sync databases read through libalpm alongside others get a
+ * handle of their own, and the local database is read on pool */
+typedef struct dbload_t {
+    char *path;
+    alpm_handle_t *handle;
+    pool_t *pool;
+    alpm_db_t *alpmdb;
+    cachekey_t key;
+    int keyed;
+    int local;
+    dbsnap_t *db;
+} dbload_t;
+
 typedef enum ntype_t {
     OP_AND,
     OP_OR,
     OP_XOR,
     OP_NOT,
 
+    /* pacman style search terms, all of which must match */
+    OP_TERMS,
+
     /* these should not exist in a query tree */
     OP_GROUP_OPEN,
     OP_GROUP_CLOSE,
@@ -110,12 +183,119 @@ typedef struct input_map_t {
     ntype_t type;
 } input_map_t;
 
+typedef int (*cmp_fn) (const void *, const void *);
+typedef int (*eq_fn) (int);
+typedef long (*resolve_fn) (size_t, const snapitem_t *);
+typedef depgraph_t* (*graph_fn) (void);
+
+/* a query leaf resolved to the functions needed to test a single package;
+ * dotted fields become a chain of selectors ending in a comparison */
+typedef struct pred_t {
+    field_t field;
+    ntype_t type;
+    void *value;
+    rx_t *rx;
+    size_t nrx;
+    literal_t *lit;
+    struct termset_t *terms;
+    bitset_t *cand;
+    int cand_ready;
+
+    int column;
+    int list;
+    int numcol;
+    int64_t range[2];
+    int pathkind;
+    bitset_t *hits;
+    cmp_fn cfn;
+    eq_fn efn;
+
+    resolve_fn rfn;
+    graph_fn gfn;
+    int recursive;
+    closure_t *closure;
+    struct pred_t *next;
+
+    /* leaves that appear more than once in a query share one pred_t and
+     * remember which packages have been tested and which matched */
+    size_t shared;
+    bitset_t *tested;
+    bitset_t *result;
+} pred_t;
+
+/* the fields a pacman style search term is looked for in */
+enum {
+    TERM_NAME,
+    TERM_DESC,
+    TERM_PROVIDES,
+    TERM_GROUP,
+
+    TERM_FIELDS
+};
+
+/* terms that are plain literals are found with a single automaton scan of
+ * each field; the others fall back to one predicate per field */
+typedef struct termset_t {
+    size_t count;
+    uint64_t acmask;
+    acmatch_t *ac;
+    pred_t **preds;
+} termset_t;
+
 typedef struct node_t {
     ntype_t type;
     void *left;
     void *right;
+    pred_t *pred;
 } node_t;
 
+/* one leaf evaluated over a range of bitset words per task */
+typedef struct filter_task_t {
+    pred_t *pred;
+    bitset_t *pkgs;
+    bitset_t *ret;
+} filter_task_t;
+
+/* a query flattened into a short-circuiting program run once per package;
+ * the accumulator holds the value of the last subexpression and PUSH/XOR
+ * use a stack for the left side of an -xor */
+typedef enum opcode_t {
+    OPC_LEAF,
+    OPC_TRUE,
+    OPC_JZ,
+    OPC_JNZ,
+    OPC_NOT,
+    OPC_PUSH,
+    OPC_XOR
+} opcode_t;
+
+typedef struct insn_t {
+    opcode_t op;
+    size_t target;
+    pred_t *pred;
+} insn_t;
+
+typedef struct program_t {
+    insn_t *code;
+    size_t len;
+    size_t size;
+    size_t depth;
+    int parallel;
+} program_t;
+
+/* packages per batch when streaming: 64 words of the package bitset */
+#define PROGRAM_BATCH_WORDS 64
+
+/* a round of batches starting at batch first; a batch stops after finding
+ * stop matches unless stop is 0 */
+typedef struct program_task_t {
+    program_t *prog;
+    bitset_t *pkgs;
+    bitset_t *ret;
+    size_t first;
+    size_t stop;
+} program_task_t;
+
 static input_map_t op_map[] = {
     {"-and", OP_AND},
     {"-or",  OP_OR},
@@ -156,6 +336,12 @@ static input_map_t cmp_map[] = {
     {NULL, 0}
 };
 
-void print_pkgs(alpm_list_t *pkgs, config_t *config);
+pred_t *pred_compile(const char *fieldname, ntype_t type, const char *value);
+void pred_free(pred_t *pred);
+int pred_match(pred_t *pred, size_t id);
+int leaf_match(pred_t *pred, size_t id);
+int compile_query(node_t *query);
+void print_pkg(size_t id, config_t *config);
+void print_pkgs(bitset_t *pkgs, config_t *config);
 
 #endif /* PACFIND_H */
@@ -0,0 +1,413 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "alpm.h"
+#include <alpm_list.h>
+
+#include "pathindex.h"
+
+#define PATHINDEX_MAGIC "pacfindp"
+#define PATHINDEX_VERSION 2
+#define PATHINDEX_BLOCK 16
+#define PATHINDEX_ALIGN(n) (((n) + 7) & ~(size_t) 7)
+
+typedef struct pathhdr_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    cachekey_t key;
+    uint64_t npkgs;
+    uint64_t names_len;
+    uint64_t npaths;
+    uint64_t nblocks;
+    uint64_t npostings;
+    uint64_t data_len;
+    uint64_t newlines;
+    uint64_t size;
+} pathhdr_t;
+
+/* a path as read from a file list, without the leading '/' */
+typedef struct pathentry_t {
+    const char *path;
+    size_t len;
+    uint32_t pkg;
+} pathentry_t;
+
+static inline unsigned char lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+}
+
+/* the index order: folded text first so case-insensitive prefixes are
+ * contiguous, then bytes so that equal paths are adjacent */
+int path_cmp(const unsigned char *a, size_t alen, const unsigned char *b, size_t blen) {
+    size_t i, n = alen < blen ? alen : blen;
+    int raw = 0;
+
+    for(i = 0; i < n; i++) {
+        if(lower(a[i]) != lower(b[i])) {
+            return lower(a[i]) < lower(b[i]) ? -1 : 1;
+        }
+        if(!raw && a[i] != b[i]) {
+            raw = a[i] < b[i] ? -1 : 1;
+        }
+    }
+    if(alen != blen) {
+        return alen < blen ? -1 : 1;
+    }
+    return raw;
+}
+
+/* compares the folded path with a lowercased key */
+int path_cmp_fold(const unsigned char *a, size_t alen, const unsigned char *key, size_t len) {
+    size_t i, n = alen < len ? alen : len;
+
+    for(i = 0; i < n; i++) {
+        if(lower(a[i]) != key[i]) {
+            return lower(a[i]) < key[i] ? -1 : 1;
+        }
+    }
+    return alen < len ? -1 : alen > len;
+}
+
+int pathentry_cmp(const void *a, const void *b) {
+    const pathentry_t *ea = a, *eb = b;
+    int c = path_cmp((const unsigned char*) ea->path, ea->len,
+            (const unsigned char*) eb->path, eb->len);
+    if(c) {
+        return c;
+    }
+    return ea->pkg < eb->pkg ? -1 : ea->pkg > eb->pkg;
+}
+
+size_t varint_put(unsigned char *out, size_t v) {
+    size_t n = 0;
+    while(v >= 0x80) {
+        out[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+size_t varint_get(const unsigned char *in, size_t *pos) {
+    size_t v = 0;
+    int shift = 0;
+    while(in[*pos] & 0x80) {
+        v |= (size_t) (in[(*pos)++] & 0x7f) << shift;
+        shift += 7;
+    }
+    v |= (size_t) in[(*pos)++] << shift;
+    return v;
+}
+
+#define PATHINDEX_SECTIONS 6
+
+void pathindex_sizes(const pathhdr_t *hdr, size_t *sizes) {
+    sizes[0] = (hdr->npkgs + 1) * sizeof(uint32_t);
+    sizes[1] = hdr->names_len;
+    sizes[2] = hdr->nblocks * sizeof(uint32_t);
+    sizes[3] = (hdr->npaths + 1) * sizeof(uint32_t);
+    sizes[4] = hdr->npostings * sizeof(uint32_t);
+    sizes[5] = hdr->data_len;
+}
+
+size_t pathindex_size(const pathhdr_t *hdr) {
+    size_t sizes[PATHINDEX_SECTIONS], off = PATHINDEX_ALIGN(sizeof(pathhdr_t)), i;
+
+    pathindex_sizes(hdr, sizes);
+    for(i = 0; i < PATHINDEX_SECTIONS; i++) {
+        off = PATHINDEX_ALIGN(off + sizes[i]);
+    }
+    return off;
+}
+
+/* points the index at the sections of buf, which starts with a header */
+int pathindex_layout(pathindex_t *idx) {
+    const pathhdr_t *hdr = (const pathhdr_t*) idx->buf;
+    size_t off = PATHINDEX_ALIGN(sizeof(pathhdr_t));
+    const void **ptrs[PATHINDEX_SECTIONS];
+    size_t sizes[PATHINDEX_SECTIONS], i;
+
+    ptrs[0] = (const void**) &idx->pkg_off;
+    ptrs[1] = (const void**) &idx->names;
+    ptrs[2] = (const void**) &idx->blocks;
+    ptrs[3] = (const void**) &idx->post_start;
+    ptrs[4] = (const void**) &idx->post_ids;
+    ptrs[5] = (const void**) &idx->data;
+    pathindex_sizes(hdr, sizes);
+
+    for(i = 0; i < PATHINDEX_SECTIONS; i++) {
+        if(off + sizes[i] > idx->size) {
+            return -1;
+        }
+        *ptrs[i] = idx->buf + off;
+        off = PATHINDEX_ALIGN(off + sizes[i]);
+    }
+
+    idx->npkgs = hdr->npkgs;
+    idx->npaths = hdr->npaths;
+    idx->nblocks = hdr->nblocks;
+    idx->newlines = hdr->newlines != 0;
+    return 0;
+}
+
+void pathentry_add(pathentry_t **entries, size_t *count, size_t *size,
+        const char *path, uint32_t pkg) {
+    size_t len = strlen(path);
+
+    /* paths longer than any path the kernel accepts are not indexed */
+    if(len + 2 > PATHINDEX_MAX) {
+        return;
+    }
+    if(*count == *size) {
+        *size *= 2;
+        *entries = realloc(*entries, *size * sizeof(pathentry_t));
+    }
+    (*entries)[*count].path = path;
+    (*entries)[*count].len = len;
+    (*entries)[(*count)++].pkg = pkg;
+}
+
+int pathentry_same(const pathentry_t *a, const pathentry_t *b) {
+    return a->len == b->len && memcmp(a->path, b->path, a->len) == 0;
+}
+
+pathindex_t *pathindex_from_alpm(alpm_db_t *db, pathkind_t kind) {
+    alpm_list_t *p, *pkgs = alpm_db_get_pkgcache(db);
+    size_t count = 0, size = 1024, names_len = 0, npaths = 0, data_max = 0;
+    size_t data_len = 0, i, j;
+    pathentry_t *entries = malloc(size * sizeof(pathentry_t));
+    pathindex_t *idx = calloc(1, sizeof(pathindex_t));
+    uint32_t *pkg_off, *blocks, *post_start, *post_ids, npkg;
+    unsigned char *data;
+    pathhdr_t hdr, *h;
+    char *names;
+
+    for(p = pkgs, npkg = 0; p; p = alpm_list_next(p), npkg++) {
+        alpm_pkg_t *pkg = p->data;
+
+        names_len += strlen(alpm_pkg_get_name(pkg)) + 1;
+        if(kind == PATH_FILES) {
+            alpm_filelist_t *files = alpm_pkg_get_files(pkg);
+            for(i = 0; files && i < files->count; i++) {
+                pathentry_add(&entries, &count, &size, files->files[i].name, npkg);
+            }
+        } else {
+            alpm_list_t *b;
+            for(b = alpm_pkg_get_backup(pkg); b; b = alpm_list_next(b)) {
+                pathentry_add(&entries, &count, &size, ((alpm_backup_t*) b->data)->name, npkg);
+            }
+        }
+    }
+
+    /* sort, drop paths a package lists twice and count the distinct ones;
+     * each path needs at most two varints and its text with a '/' */
+    qsort(entries, count, sizeof(pathentry_t), pathentry_cmp);
+    for(i = j = 0; i < count; i++) {
+        if(j && pathentry_same(&entries[i], &entries[j - 1])) {
+            if(entries[i].pkg == entries[j - 1].pkg) {
+                continue;
+            }
+        } else {
+            npaths++;
+            data_max += entries[i].len + 1 + 2 * 10;
+        }
+        entries[j++] = entries[i];
+    }
+    count = j;
+
+    memset(&hdr, 0, sizeof(pathhdr_t));
+    memcpy(hdr.magic, PATHINDEX_MAGIC, sizeof(hdr.magic));
+    hdr.version = PATHINDEX_VERSION;
+    hdr.kind = kind;
+    hdr.npkgs = npkg;
+    hdr.names_len = names_len;
+    hdr.npaths = npaths;
+    hdr.nblocks = (npaths + PATHINDEX_BLOCK - 1) / PATHINDEX_BLOCK;
+    hdr.npostings = count;
+    hdr.data_len = data_max;
+
+    /* the data section comes last, so it can be trimmed once filled */
+    idx->size = pathindex_size(&hdr);
+    idx->buf = calloc(1, idx->size);
+    memcpy(idx->buf, &hdr, sizeof(pathhdr_t));
+    pathindex_layout(idx);
+    pkg_off = (uint32_t*) idx->pkg_off;
+    names = (char*) idx->names;
+    blocks = (uint32_t*) idx->blocks;
+    post_start = (uint32_t*) idx->post_start;
+    post_ids = (uint32_t*) idx->post_ids;
+    data = (unsigned char*) idx->data;
+
+    names_len = 0;
+    for(p = pkgs, npkg = 0; p; p = alpm_list_next(p), npkg++) {
+        const char *name = alpm_pkg_get_name(p->data);
+        pkg_off[npkg] = names_len;
+        strcpy(names + names_len, name);
+        names_len += strlen(name) + 1;
+    }
+    pkg_off[npkg] = names_len;
+
+    npaths = 0;
+    for(i = 0; i < count; i++) {
+        const pathentry_t *e = &entries[i], *prev = i ? &entries[i - 1] : NULL;
+        size_t shared = 0;
+
+        if(prev && pathentry_same(e, prev)) {
+            /* the same path in another package */
+            post_ids[post_start[npaths]++] = e->pkg;
+            continue;
+        }
+
+        /* stored paths have their leading '/', which always matches */
+        if(npaths % PATHINDEX_BLOCK == 0) {
+            blocks[npaths / PATHINDEX_BLOCK] = data_len;
+        } else {
+            while(shared < e->len && shared < prev->len && e->path[shared] == prev->path[shared]) {
+                shared++;
+            }
+            shared++;
+        }
+        data_len += varint_put(data + data_len, shared);
+        data_len += varint_put(data + data_len, e->len + 1 - shared);
+        if(shared == 0) {
+            data[data_len++] = '/';
+            shared = 1;
+        }
+        memcpy(data + data_len, e->path + shared - 1, e->len + 1 - shared);
+        data_len += e->len + 1 - shared;
+
+        if(memchr(e->path, '\n', e->len)) {
+            hdr.newlines = 1;
+        }
+
+        npaths++;
+        post_start[npaths] = post_start[npaths - 1];
+        post_ids[post_start[npaths]++] = e->pkg;
+    }
+    free(entries);
+
+    hdr.data_len = data_len;
+    hdr.size = pathindex_size(&hdr);
+    h = (pathhdr_t*) idx->buf;
+    *h = hdr;
+    idx->size = hdr.size;
+    idx->newlines = hdr.newlines != 0;
+
+    return idx;
+}
+
+pathindex_t *pathindex_load(const char *name, pathkind_t kind, const cachekey_t *key) {
+    pathindex_t *idx = calloc(1, sizeof(pathindex_t));
+    const pathhdr_t *hdr;
+
+    if((idx->buf = cache_map(name, key, &idx->size)) == NULL) {
+        free(idx);
+        return NULL;
+    }
+    idx->mapped = 1;
+
+    hdr = (const pathhdr_t*) idx->buf;
+    if(idx->size < sizeof(pathhdr_t)
+            || memcmp(hdr->magic, PATHINDEX_MAGIC, sizeof(hdr->magic)) != 0
+            || hdr->version != PATHINDEX_VERSION || hdr->kind != kind
+            || memcmp(&hdr->key, key, sizeof(cachekey_t)) != 0
+            || hdr->size != idx->size || pathindex_size(hdr) != idx->size
+            || pathindex_layout(idx) != 0) {
+        pathindex_free(idx);
+        return NULL;
+    }
+
+    return idx;
+}
+
+int pathindex_save(pathindex_t *idx, const char *name, const cachekey_t *key) {
+    ((pathhdr_t*) idx->buf)->key = *key;
+    return cache_write(name, key, idx->buf, idx->size);
+}
+
+void pathindex_free(pathindex_t *idx) {
+    if(idx == NULL) {
+        return;
+    }
+    if(idx->mapped) {
+        munmap(idx->buf, idx->size);
+    } else {
+        free(idx->buf);
+    }
+    free(idx->ids);
+    free(idx);
+}
+
+void pathiter_block(const pathindex_t *idx, size_t block, pathiter_t *it) {
+    it->idx = idx;
+    it->i = block * PATHINDEX_BLOCK - 1;
+    it->pos = idx->blocks[block];
+    it->len = 0;
+    pathiter_next(it);
+}
+
+void pathiter_first(const pathindex_t *idx, pathiter_t *it) {
+    if(idx->npaths == 0) {
+        it->idx = idx;
+        it->i = 0;
+        it->len = 0;
+        return;
+    }
+    pathiter_block(idx, 0, it);
+}
+
+int pathiter_next(pathiter_t *it) {
+    const pathindex_t *idx = it->idx;
+    size_t shared, len;
+
+    if(it->i + 1 >= idx->npaths) {
+        it->i = idx->npaths;
+        return 0;
+    }
+    shared = varint_get(idx->data, &it->pos);
+    len = varint_get(idx->data, &it->pos);
+    if(shared > it->len || shared + len >= PATHINDEX_MAX) {
+        it->i = idx->npaths;
+        return 0;
+    }
+    memcpy(it->path + shared, idx->data + it->pos, len);
+    it->pos += len;
+    it->len = shared + len;
+    it->path[it->len] = '\0';
+    it->i++;
+    return 1;
+}
+
+int pathiter_before(const pathiter_t *it, const char *key, size_t len, int fold) {
+    const unsigned char *path = (const unsigned char*) it->path;
+    if(fold) {
+        return path_cmp_fold(path, it->len, (const unsigned char*) key, len) < 0;
+    }
+    return path_cmp(path, it->len, (const unsigned char*) key, len) < 0;
+}
+
+void pathiter_seek(const pathindex_t *idx, const char *key, size_t len, int fold, pathiter_t *it) {
+    size_t lo = 0, hi = idx->nblocks;
+
+    /* the last block starting before key */
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        pathiter_block(idx, mid, it);
+        if(pathiter_before(it, key, len, fold)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if(lo == 0) {
+        pathiter_first(idx, it);
+    } else {
+        pathiter_block(idx, lo - 1, it);
+    }
+    while(it->i < idx->npaths && pathiter_before(it, key, len, fold)) {
+        pathiter_next(it);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef PACFIND_PATHINDEX_H
+#define PACFIND_PATHINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alpm.h"
+
+#include "cache.h"
+
+typedef enum pathkind_t {
+    PATH_FILES,
+    PATH_BACKUP
+} pathkind_t;
+
+/* longest path stored, including the leading '/' */
+#define PATHINDEX_MAX 4096
+
+/* every path in the file (or backup) lists of one database, sorted by
+ * ASCII-folded text and then by bytes, each with the packages that own it;
+ * paths are front-coded against the previous path and every
+ * PATHINDEX_BLOCK-th path is stored whole so lookups can binary search */
+typedef struct pathindex_t {
+    char *buf;
+    size_t size;
+    int mapped;
+
+    size_t npkgs;
+    const uint32_t *pkg_off;
+    const char *names;
+
+    size_t npaths;
+    size_t nblocks;
+    const uint32_t *blocks;
+    const uint32_t *post_start;
+    const uint32_t *post_ids;
+    const unsigned char *data;
+    int newlines;
+
+    /* snapshot id of each package, filled in by the caller */
+    uint32_t *ids;
+} pathindex_t;
+
+typedef struct pathiter_t {
+    const pathindex_t *idx;
+    size_t i;
+    size_t pos;
+    size_t len;
+    char path[PATHINDEX_MAX];
+} pathiter_t;
+
+pathindex_t *pathindex_from_alpm(alpm_db_t *db, pathkind_t kind);
+pathindex_t *pathindex_load(const char *name, pathkind_t kind, const cachekey_t *key);
+int pathindex_save(pathindex_t *idx, const char *name, const cachekey_t *key);
+void pathindex_free(pathindex_t *idx);
+
+static inline const char *pathindex_pkgname(const pathindex_t *idx, size_t p) {
+    return idx->names + idx->pkg_off[p];
+}
+
+/* positions the iterator on the first path, the first path not before key,
+ * or (fold) the first path whose folded text is not before the already
+ * lowercased key; it->i is npaths when there is none */
+void pathiter_first(const pathindex_t *idx, pathiter_t *it);
+void pathiter_seek(const pathindex_t *idx, const char *key, size_t len, int fold, pathiter_t *it);
+int pathiter_next(pathiter_t *it);
+
+#endif /* PACFIND_PATHINDEX_H */
@@ -0,0 +1,118 @@
+#include <signal.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+typedef struct poolarg_t {
+    pool_t *pool;
+    size_t worker;
+} poolarg_t;
+
+/* called with the lock held */
+void pool_work(pool_t *pool, size_t worker) {
+    while(pool->next < pool->ntasks) {
+        size_t task = pool->next++;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool->fn(pool->ctx, task, worker);
+        pthread_mutex_lock(&pool->lock);
+
+        if(++pool->finished == pool->ntasks) {
+            pthread_cond_broadcast(&pool->done);
+        }
+    }
+}
+
+void *pool_thread(void *arg) {
+    poolarg_t *parg = arg;
+    pool_t *pool = parg->pool;
+    size_t worker = parg->worker;
+    unsigned long seen = 0;
+
+    free(parg);
+
+    pthread_mutex_lock(&pool->lock);
+    for(;;) {
+        while(!pool->quit && pool->generation == seen) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if(pool->quit) {
+            break;
+        }
+        seen = pool->generation;
+        pool_work(pool, worker);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+pool_t *pool_new(size_t nthreads) {
+    pool_t *pool = calloc(1, sizeof(pool_t));
+    sigset_t all, old;
+    size_t i;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->threads = calloc(nthreads, sizeof(pthread_t));
+    pool->nthreads = 1;
+    /* signals are left to the thread that created the pool, which may be
+     * waiting for them on a signalfd */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for(i = 1; i < nthreads; i++) {
+        poolarg_t *arg = malloc(sizeof(poolarg_t));
+        arg->pool = pool;
+        arg->worker = i;
+        if(pthread_create(&pool->threads[pool->nthreads], NULL, pool_thread, arg) != 0) {
+            free(arg);
+            break;
+        }
+        pool->nthreads++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    return pool;
+}
+
+void pool_run(pool_t *pool, size_t ntasks, task_fn fn, void *ctx) {
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->ntasks = ntasks;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+
+    pool_work(pool, 0);
+    while(pool->finished < pool->ntasks) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_free(pool_t *pool) {
+    size_t i;
+
+    if(pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(i = 1; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool);
+}
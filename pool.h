@@ -0,0 +1,31 @@
+#ifndef PACFIND_POOL_H
+#define PACFIND_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+typedef void (*task_fn) (void *ctx, size_t task, size_t worker);
+
+/* a fixed set of worker threads that run numbered tasks; the thread calling
+ * pool_run takes part as worker 0 */
+typedef struct pool_t {
+    size_t nthreads;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+
+    task_fn fn;
+    void *ctx;
+    size_t ntasks;
+    size_t next;
+    size_t finished;
+    unsigned long generation;
+    int quit;
+} pool_t;
+
+pool_t *pool_new(size_t nthreads);
+void pool_run(pool_t *pool, size_t ntasks, task_fn fn, void *ctx);
+void pool_free(pool_t *pool);
+
+#endif /* PACFIND_POOL_H */
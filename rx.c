@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+
+#ifdef HAVE_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#endif
+
+#include "ere.h"
+#include "dfa.h"
+#include "rx.h"
+
+#define RX_FLAGS (REG_EXTENDED | REG_NOSUB | REG_ICASE | REG_NEWLINE)
+
+void *posix_compile(const char *pattern) {
+    regex_t *re = malloc(sizeof(regex_t));
+    if(regcomp(re, pattern, RX_FLAGS) != 0) {
+        free(re);
+        return NULL;
+    }
+    return re;
+}
+
+int posix_exec(void *re, const char *str, size_t len) {
+    (void) len;
+    return regexec(re, str, 0, 0, 0) == 0;
+}
+
+void posix_free(void *re) {
+    regfree(re);
+    free(re);
+}
+
+void *dfa_engine_compile(const char *pattern) {
+    return dfa_compile(pattern, 1);
+}
+
+int dfa_engine_exec(void *re, const char *str, size_t len) {
+    return dfa_exec(re, str, len);
+}
+
+void dfa_engine_free(void *re) {
+    dfa_free(re);
+}
+
+#ifdef HAVE_PCRE2
+typedef struct pcre_t {
+    pcre2_code *code;
+    pcre2_match_data *md;
+} pcre_t;
+
+typedef struct strbuf_t {
+    char *buf;
+    size_t len;
+    size_t size;
+} strbuf_t;
+
+void strbuf_add(strbuf_t *sb, const char *str) {
+    size_t len = strlen(str);
+    if(sb->len + len + 1 > sb->size) {
+        while(sb->len + len + 1 > sb->size) {
+            sb->size = sb->size ? sb->size * 2 : 64;
+        }
+        sb->buf = realloc(sb->buf, sb->size);
+    }
+    memcpy(sb->buf + sb->len, str, len + 1);
+    sb->len += len;
+}
+
+/* writes the parsed regex back out in PCRE syntax; every character is
+ * spelled as a hex escape so no PCRE extension can change its meaning */
+void pcre_emit(strbuf_t *sb, const ere_t *ere, int node) {
+    const erenode_t *n = ere->nodes + node;
+    char tmp[32];
+    int c, lo;
+
+    switch(n->type) {
+        case ERE_SET:
+            strbuf_add(sb, "[");
+            for(c = 0; c < 256; c++) {
+                if(!ere_set_test(n->set, c)) {
+                    continue;
+                }
+                for(lo = c; c + 1 < 256 && ere_set_test(n->set, c + 1); c++);
+                if(lo == c) {
+                    snprintf(tmp, sizeof(tmp), "\\x{%x}", lo);
+                } else {
+                    snprintf(tmp, sizeof(tmp), "\\x{%x}-\\x{%x}", lo, c);
+                }
+                strbuf_add(sb, tmp);
+            }
+            /* an empty set is spelled as one that cannot match */
+            strbuf_add(sb, n->set[0] | n->set[1] | n->set[2] | n->set[3] ? "]" : "^\\x{0}-\\x{ff}]");
+            break;
+        case ERE_CAT:
+            pcre_emit(sb, ere, n->left);
+            pcre_emit(sb, ere, n->right);
+            break;
+        case ERE_ALT:
+            strbuf_add(sb, "(?:");
+            pcre_emit(sb, ere, n->left);
+            strbuf_add(sb, "|");
+            pcre_emit(sb, ere, n->right);
+            strbuf_add(sb, ")");
+            break;
+        case ERE_STAR:
+        case ERE_PLUS:
+        case ERE_QUEST:
+            strbuf_add(sb, "(?:");
+            pcre_emit(sb, ere, n->left);
+            strbuf_add(sb, n->type == ERE_STAR ? ")*" : n->type == ERE_PLUS ? ")+" : ")?");
+            break;
+        case ERE_BOL:
+            strbuf_add(sb, "^");
+            break;
+        case ERE_EOL:
+            strbuf_add(sb, "$");
+            break;
+        case ERE_EMPTY:
+            strbuf_add(sb, "(?:)");
+            break;
+    }
+}
+
+void *pcre_compile(const char *pattern) {
+    ere_t *ere = ere_parse(pattern, 1);
+    strbuf_t sb = { NULL, 0, 0 };
+    PCRE2_SIZE erroff;
+    pcre_t *re;
+    int err;
+
+    if(ere == NULL) {
+        return NULL;
+    }
+    pcre_emit(&sb, ere, ere->root);
+    ere_free(ere);
+
+    re = calloc(1, sizeof(pcre_t));
+    re->code = pcre2_compile((PCRE2_SPTR) sb.buf, sb.len,
+            PCRE2_MULTILINE | PCRE2_ALT_CIRCUMFLEX | PCRE2_NO_AUTO_CAPTURE,
+            &err, &erroff, NULL);
+    free(sb.buf);
+    if(re->code == NULL) {
+        free(re);
+        return NULL;
+    }
+    pcre2_jit_compile(re->code, PCRE2_JIT_COMPLETE);
+    re->md = pcre2_match_data_create_from_pattern(re->code, NULL);
+    return re;
+}
+
+int pcre_exec(void *re, const char *str, size_t len) {
+    pcre_t *p = re;
+    return pcre2_match(p->code, (PCRE2_SPTR) str, len, 0, 0, p->md, NULL) >= 0;
+}
+
+void pcre_free(void *re) {
+    pcre_t *p = re;
+    pcre2_match_data_free(p->md);
+    pcre2_code_free(p->code);
+    free(p);
+}
+#endif
+
+const rxengine_t rx_engines[] = {
+    {"posix", posix_compile, posix_exec, posix_free},
+    {"dfa", dfa_engine_compile, dfa_engine_exec, dfa_engine_free},
+#ifdef HAVE_PCRE2
+    {"pcre2", pcre_compile, pcre_exec, pcre_free},
+#endif
+    {NULL, NULL, NULL, NULL}
+};
+
+const rxengine_t *rx_engine(const char *name) {
+    int i;
+    for(i = 0; rx_engines[i].name; i++) {
+        if(strcmp(rx_engines[i].name, name) == 0) {
+            return rx_engines + i;
+        }
+    }
+    return NULL;
+}
+
+/* every pattern is checked by regcomp so that errors are reported the same
+ * way whatever the engine; patterns outside an engine's subset stay with
+ * POSIX */
+int rx_compile(rx_t *rx, const rxengine_t *engine, const char *pattern) {
+    const rxengine_t *posix = rx_engines;
+    void *re;
+
+    if((re = posix->compile(pattern)) == NULL) {
+        return -1;
+    }
+    rx->engine = posix;
+    rx->re = re;
+
+    if(engine != posix && (re = engine->compile(pattern))) {
+        posix->free(rx->re);
+        rx->engine = engine;
+        rx->re = re;
+    }
+    return 0;
+}
+
+void rx_free(rx_t *rx) {
+    if(rx->engine) {
+        rx->engine->free(rx->re);
+        rx->engine = NULL;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef PACFIND_RX_H
+#define PACFIND_RX_H
+
+#include <stddef.h>
+
+/* a regex implementation; compile returns NULL for patterns the engine
+ * cannot match with exactly the POSIX semantics */
+typedef struct rxengine_t {
+    const char *name;
+    void *(*compile) (const char *pattern);
+    int (*exec) (void *re, const char *str, size_t len);
+    void (*free) (void *re);
+} rxengine_t;
+
+typedef struct rx_t {
+    const rxengine_t *engine;
+    void *re;
+} rx_t;
+
+#ifndef REGEX_ENGINE_DEFAULT
+#define REGEX_ENGINE_DEFAULT "dfa"
+#endif
+
+const rxengine_t *rx_engine(const char *name);
+int rx_compile(rx_t *rx, const rxengine_t *engine, const char *pattern);
+void rx_free(rx_t *rx);
+
+static inline int rx_exec(rx_t *rx, const char *str, size_t len) {
+    return rx->engine->exec(rx->re, str, len);
+}
+
+#endif /* PACFIND_RX_H */
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "alpm.h"
+#include <alpm_list.h>
+
+#include "snapshot.h"
+
+dbsnap_t *dbsnap_new(const char *dbname, int local, size_t count) {
+    dbsnap_t *db = calloc(1, sizeof(dbsnap_t));
+    size_t n = count ? count : 1;
+    int c;
+
+    db->dbname = strdup(dbname);
+    db->local = local;
+    db->count = count;
+
+    db->arena_size = 4096;
+    db->arena = malloc(db->arena_size);
+
+    for(c = 0; c < SCOL_COUNT; c++) {
+        db->str_off[c] = malloc(n * sizeof(uint32_t));
+        db->str_len[c] = malloc(n * sizeof(uint32_t));
+    }
+    for(c = 0; c < LCOL_COUNT; c++) {
+        db->list_start[c] = calloc(count + 1, sizeof(uint32_t));
+        db->list_size[c] = 64;
+        db->list_items[c] = malloc(db->list_size[c] * sizeof(snapitem_t));
+    }
+    for(c = 0; c < NCOL_COUNT; c++) {
+        db->num[c] = calloc(n, sizeof(int64_t));
+    }
+
+    return db;
+}
+
+void dbsnap_free(dbsnap_t *db) {
+    int c;
+
+    if(db == NULL) {
+        return;
+    }
+
+    if(db->map) {
+        munmap(db->map, db->map_size);
+        free(db->dbname);
+        free(db);
+        return;
+    }
+
+    for(c = 0; c < SCOL_COUNT; c++) {
+        free(db->str_off[c]);
+        free(db->str_len[c]);
+    }
+    for(c = 0; c < LCOL_COUNT; c++) {
+        free(db->list_start[c]);
+        free(db->list_items[c]);
+    }
+    for(c = 0; c < NCOL_COUNT; c++) {
+        free(db->num[c]);
+    }
+    free(db->tri_keys);
+    free(db->tri_start);
+    free(db->tri_ids);
+    free(db->arena);
+    free(db->dbname);
+    free(db);
+}
+
+uint32_t dbsnap_intern(dbsnap_t *db, const char *str, uint32_t *len) {
+    size_t l, off = db->arena_len;
+
+    if(str == NULL) {
+        *len = 0;
+        return SNAP_NULL;
+    }
+
+    l = strlen(str);
+    if(db->arena_len + l + 1 > db->arena_size) {
+        while(db->arena_len + l + 1 > db->arena_size) {
+            db->arena_size *= 2;
+        }
+        db->arena = realloc(db->arena, db->arena_size);
+    }
+
+    memcpy(db->arena + off, str, l + 1);
+    db->arena_len += l + 1;
+    *len = l;
+    return off;
+}
+
+void dbsnap_set_str(dbsnap_t *db, strcol_t col, size_t i, const char *str) {
+    db->str_off[col][i] = dbsnap_intern(db, str, &db->str_len[col][i]);
+}
+
+snapitem_t *dbsnap_add_item(dbsnap_t *db, listcol_t col, const char *str) {
+    snapitem_t *item;
+
+    if(db->list_len[col] == db->list_size[col]) {
+        db->list_size[col] *= 2;
+        db->list_items[col] = realloc(db->list_items[col],
+                db->list_size[col] * sizeof(snapitem_t));
+    }
+
+    item = db->list_items[col] + db->list_len[col]++;
+    item->str = dbsnap_intern(db, str, &item->len);
+    item->version = SNAP_NULL;
+    item->mod = ALPM_DEP_MOD_ANY;
+    return item;
+}
+
+void dbsnap_add_strings(dbsnap_t *db, listcol_t col, size_t i, alpm_list_t *list) {
+    for(; list; list = alpm_list_next(list)) {
+        dbsnap_add_item(db, col, list->data);
+    }
+    db->list_start[col][i + 1] = db->list_len[col];
+}
+
+void dbsnap_add_depends(dbsnap_t *db, listcol_t col, size_t i, alpm_list_t *list) {
+    for(; list; list = alpm_list_next(list)) {
+        alpm_depend_t *dep = list->data;
+        snapitem_t *item = dbsnap_add_item(db, col, dep->name);
+        uint32_t len;
+        item->version = dbsnap_intern(db, dep->version, &len);
+        item->mod = dep->mod;
+    }
+    db->list_start[col][i + 1] = db->list_len[col];
+}
+
+/* optional dependencies are kept whole, "name: description", as they are
+ * written in the database */
+void dbsnap_add_optdepends(dbsnap_t *db, size_t i, alpm_list_t *list) {
+    for(; list; list = alpm_list_next(list)) {
+        char *str = alpm_dep_compute_string(list->data);
+        if(str) {
+            dbsnap_add_item(db, LCOL_OPTDEPENDS, str);
+            free(str);
+        }
+    }
+    db->list_start[LCOL_OPTDEPENDS][i + 1] = db->list_len[LCOL_OPTDEPENDS];
+}
+
+dbsnap_t *dbsnap_from_alpm(alpm_db_t *alpmdb, int local) {
+    alpm_list_t *p = alpm_db_get_pkgcache(alpmdb);
+    dbsnap_t *db = dbsnap_new(alpm_db_get_name(alpmdb), local, alpm_list_count(p));
+    size_t i;
+
+    for(i = 0; p; p = alpm_list_next(p), i++) {
+        alpm_pkg_t *pkg = p->data;
+
+        dbsnap_set_str(db, SCOL_FILENAME, i, alpm_pkg_get_filename(pkg));
+        dbsnap_set_str(db, SCOL_NAME, i, alpm_pkg_get_name(pkg));
+        dbsnap_set_str(db, SCOL_DESC, i, alpm_pkg_get_desc(pkg));
+        dbsnap_set_str(db, SCOL_VERSION, i, alpm_pkg_get_version(pkg));
+        dbsnap_set_str(db, SCOL_URL, i, alpm_pkg_get_url(pkg));
+        dbsnap_set_str(db, SCOL_PACKAGER, i, alpm_pkg_get_packager(pkg));
+        dbsnap_set_str(db, SCOL_MD5SUM, i, alpm_pkg_get_md5sum(pkg));
+        dbsnap_set_str(db, SCOL_SHA256SUM, i, alpm_pkg_get_sha256sum(pkg));
+        dbsnap_set_str(db, SCOL_ARCH, i, alpm_pkg_get_arch(pkg));
+
+        dbsnap_add_strings(db, LCOL_LICENSE, i, alpm_pkg_get_licenses(pkg));
+        dbsnap_add_strings(db, LCOL_GROUP, i, alpm_pkg_get_groups(pkg));
+        dbsnap_add_depends(db, LCOL_DEPENDS, i, alpm_pkg_get_depends(pkg));
+        dbsnap_add_optdepends(db, i, alpm_pkg_get_optdepends(pkg));
+        dbsnap_add_depends(db, LCOL_CONFLICTS, i, alpm_pkg_get_conflicts(pkg));
+        dbsnap_add_depends(db, LCOL_PROVIDES, i, alpm_pkg_get_provides(pkg));
+        dbsnap_add_depends(db, LCOL_REPLACES, i, alpm_pkg_get_replaces(pkg));
+
+        db->num[NCOL_SIZE][i] = alpm_pkg_get_size(pkg);
+        db->num[NCOL_ISIZE][i] = alpm_pkg_get_isize(pkg);
+        db->num[NCOL_BUILDDATE][i] = alpm_pkg_get_builddate(pkg);
+        db->num[NCOL_INSTALLDATE][i] = alpm_pkg_get_installdate(pkg);
+        db->num[NCOL_REASON][i] = alpm_pkg_get_reason(pkg);
+    }
+
+    return db;
+}
+
+snapshot_t *snapshot_new(dbsnap_t **dbs, size_t ndbs) {
+    snapshot_t *snap = calloc(1, sizeof(snapshot_t));
+    size_t d, i, id = 0;
+
+    snap->ndbs = ndbs;
+    snap->dbs = malloc((ndbs ? ndbs : 1) * sizeof(dbsnap_t*));
+    snap->base = malloc((ndbs ? ndbs : 1) * sizeof(size_t));
+
+    for(d = 0; d < ndbs; d++) {
+        snap->dbs[d] = dbs[d];
+        snap->base[d] = snap->count;
+        snap->count += dbs[d]->count;
+    }
+
+    snap->db_of = malloc((snap->count ? snap->count : 1) * sizeof(uint16_t));
+    for(d = 0; d < ndbs; d++) {
+        for(i = 0; i < dbs[d]->count; i++) {
+            snap->db_of[id++] = d;
+        }
+    }
+
+    return snap;
+}
+
+void snapshot_free(snapshot_t *snap) {
+    size_t d;
+
+    if(snap == NULL) {
+        return;
+    }
+
+    for(d = 0; d < snap->ndbs; d++) {
+        dbsnap_free(snap->dbs[d]);
+    }
+    free(snap->dbs);
+    free(snap->base);
+    free(snap->db_of);
+    free(snap);
+}
@@ -0,0 +1,161 @@
+#ifndef PACFIND_SNAPSHOT_H
+#define PACFIND_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alpm.h"
+
+#define SNAP_NULL UINT32_MAX
+
+typedef enum strcol_t {
+    SCOL_FILENAME,
+    SCOL_NAME,
+    SCOL_DESC,
+    SCOL_VERSION,
+    SCOL_URL,
+    SCOL_PACKAGER,
+    SCOL_MD5SUM,
+    SCOL_SHA256SUM,
+    SCOL_ARCH,
+
+    SCOL_COUNT
+} strcol_t;
+
+typedef enum listcol_t {
+    LCOL_LICENSE,
+    LCOL_GROUP,
+    LCOL_DEPENDS,
+    LCOL_OPTDEPENDS,
+    LCOL_CONFLICTS,
+    LCOL_PROVIDES,
+    LCOL_REPLACES,
+
+    LCOL_COUNT
+} listcol_t;
+
+typedef enum numcol_t {
+    NCOL_SIZE,
+    NCOL_ISIZE,
+    NCOL_BUILDDATE,
+    NCOL_INSTALLDATE,
+    NCOL_REASON,
+
+    NCOL_COUNT
+} numcol_t;
+
+/* an entry in a list column; dependency lists store the dependency name as
+ * the entry text */
+typedef struct snapitem_t {
+    uint32_t str;
+    uint32_t len;
+    uint32_t version;
+    uint32_t mod;
+} snapitem_t;
+
+/* the packages of one database stored column by column; strings live in a
+ * single arena and are referenced by offset, list columns are stored as
+ * item ranges (start[i] through start[i + 1] - 1) */
+typedef struct dbsnap_t {
+    char *dbname;
+    int local;
+    size_t count;
+
+    char *arena;
+    size_t arena_len;
+    size_t arena_size;
+
+    uint32_t *str_off[SCOL_COUNT];
+    uint32_t *str_len[SCOL_COUNT];
+
+    uint32_t *list_start[LCOL_COUNT];
+    snapitem_t *list_items[LCOL_COUNT];
+    size_t list_len[LCOL_COUNT];
+    size_t list_size[LCOL_COUNT];
+
+    int64_t *num[NCOL_COUNT];
+
+    /* trigram posting lists, see trigram.h; NULL unless built */
+    uint32_t *tri_keys;
+    uint32_t *tri_start;
+    uint32_t *tri_ids;
+    size_t tri_nkeys;
+    size_t tri_nids;
+
+    /* set when the columns point into a mapped cache file */
+    void *map;
+    size_t map_size;
+} dbsnap_t;
+
+/* several databases viewed as one dense range of package ids */
+typedef struct snapshot_t {
+    size_t count;
+    size_t ndbs;
+    dbsnap_t **dbs;
+    size_t *base;
+    uint16_t *db_of;
+} snapshot_t;
+
+dbsnap_t *dbsnap_new(const char *dbname, int local, size_t count);
+dbsnap_t *dbsnap_from_alpm(alpm_db_t *db, int local);
+void dbsnap_free(dbsnap_t *db);
+
+/* for filling a dbsnap_t package by package; str is copied into the arena
+ * and may be NULL.  Items are added to package i until
+ * list_start[col][i + 1] is set */
+uint32_t dbsnap_intern(dbsnap_t *db, const char *str, uint32_t *len);
+void dbsnap_set_str(dbsnap_t *db, strcol_t col, size_t i, const char *str);
+snapitem_t *dbsnap_add_item(dbsnap_t *db, listcol_t col, const char *str);
+
+snapshot_t *snapshot_new(dbsnap_t **dbs, size_t ndbs);
+void snapshot_free(snapshot_t *snap);
+
+static inline const dbsnap_t *snap_db(const snapshot_t *snap, size_t id, size_t *i) {
+    size_t d = snap->db_of[id];
+    *i = id - snap->base[d];
+    return snap->dbs[d];
+}
+
+static inline const char *snap_str(const snapshot_t *snap, strcol_t col, size_t id) {
+    size_t i;
+    const dbsnap_t *db = snap_db(snap, id, &i);
+    uint32_t off = db->str_off[col][i];
+    return off == SNAP_NULL ? NULL : db->arena + off;
+}
+
+static inline uint32_t snap_strlen(const snapshot_t *snap, strcol_t col, size_t id) {
+    size_t i;
+    const dbsnap_t *db = snap_db(snap, id, &i);
+    return db->str_len[col][i];
+}
+
+static inline const snapitem_t *snap_list(const snapshot_t *snap, listcol_t col,
+        size_t id, size_t *count) {
+    size_t i;
+    const dbsnap_t *db = snap_db(snap, id, &i);
+    *count = db->list_start[col][i + 1] - db->list_start[col][i];
+    return db->list_items[col] + db->list_start[col][i];
+}
+
+/* item strings belong to the arena of the package they were read from */
+static inline const char *snap_item_str(const snapshot_t *snap, size_t id, uint32_t off) {
+    size_t i;
+    const dbsnap_t *db = snap_db(snap, id, &i);
+    return off == SNAP_NULL ? NULL : db->arena + off;
+}
+
+static inline int64_t snap_num(const snapshot_t *snap, numcol_t col, size_t id) {
+    size_t i;
+    const dbsnap_t *db = snap_db(snap, id, &i);
+    return db->num[col][i];
+}
+
+static inline const char *snap_dbname(const snapshot_t *snap, size_t id) {
+    return snap->dbs[snap->db_of[id]]->dbname;
+}
+
+static inline int snap_local(const snapshot_t *snap, size_t id) {
+    return snap->dbs[snap->db_of[id]]->local;
+}
+
+#endif /* PACFIND_SNAPSHOT_H */
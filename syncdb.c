@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include "desc.h"
+#include "syncdb.h"
+
+/* the desc sections libalpm reads from a sync database; anything else
+ * (%BASE%, %PGPSIG%, ...) is skipped */
+const descfield_t syncdb_fields[] = {
+    { "%FILENAME%", DESC_STR, SCOL_FILENAME },
+    { "%NAME%", DESC_STR, SCOL_NAME },
+    { "%DESC%", DESC_STR, SCOL_DESC },
+    { "%VERSION%", DESC_STR, SCOL_VERSION },
+    { "%URL%", DESC_STR, SCOL_URL },
+    { "%PACKAGER%", DESC_STR, SCOL_PACKAGER },
+    { "%MD5SUM%", DESC_STR, SCOL_MD5SUM },
+    { "%SHA256SUM%", DESC_STR, SCOL_SHA256SUM },
+    { "%ARCH%", DESC_STR, SCOL_ARCH },
+    { "%CSIZE%", DESC_NUM, NCOL_SIZE },
+    { "%SIZE%", DESC_NUM, NCOL_SIZE },
+    { "%ISIZE%", DESC_NUM, NCOL_ISIZE },
+    { "%BUILDDATE%", DESC_NUM, NCOL_BUILDDATE },
+    { "%LICENSE%", DESC_LIST, LCOL_LICENSE },
+    { "%GROUPS%", DESC_LIST, LCOL_GROUP },
+    { "%OPTDEPENDS%", DESC_LIST, LCOL_OPTDEPENDS },
+    { "%DEPENDS%", DESC_DEPENDS, LCOL_DEPENDS },
+    { "%CONFLICTS%", DESC_DEPENDS, LCOL_CONFLICTS },
+    { "%PROVIDES%", DESC_DEPENDS, LCOL_PROVIDES },
+    { "%REPLACES%", DESC_DEPENDS, LCOL_REPLACES },
+    { NULL, 0, 0 }
+};
+
+/* the archive is decompressed once, keeping only the desc and depends
+ * entries, which are then parsed where they were decompressed to */
+dbsnap_t *syncdb_read(const char *path, const char *dbname) {
+    struct archive *a = archive_read_new();
+    struct archive_entry *entry;
+    descpkg_t *pkgs = NULL;
+    size_t npkgs = 0, pkgsize = 0, len = 0, size = 1 << 20, i;
+    char *text = malloc(size), *lastdir = NULL;
+    dbsnap_t *db = NULL;
+    int r;
+
+    archive_read_support_filter_all(a);
+    archive_read_support_format_all(a);
+    if(archive_read_open_filename(a, path, 128 * 1024) != ARCHIVE_OK) {
+        goto cleanup;
+    }
+
+    while((r = archive_read_next_header(a, &entry)) == ARCHIVE_OK) {
+        const char *name = archive_entry_pathname(entry), *file;
+        la_int64_t esize = archive_entry_size(entry);
+        la_ssize_t got;
+        size_t start = len;
+
+        if(name == NULL || (file = strrchr(name, '/')) == NULL
+                || (strcmp(file + 1, "desc") != 0 && strcmp(file + 1, "depends") != 0)) {
+            continue;
+        }
+
+        /* a depends file belongs to the desc file read just before it */
+        if(lastdir == NULL || strncmp(lastdir, name, file - name) != 0
+                || lastdir[file - name] != '\0') {
+            if(npkgs == pkgsize) {
+                pkgsize = pkgsize ? pkgsize * 2 : 1024;
+                pkgs = realloc(pkgs, pkgsize * sizeof(descpkg_t));
+            }
+            pkgs[npkgs].len = 0;
+            npkgs++;
+            free(lastdir);
+            lastdir = strndup(name, file - name);
+        }
+
+        if(esize < 0) {
+            esize = 0;
+        }
+        while(len + esize + 2 > size) {
+            size *= 2;
+            text = realloc(text, size);
+        }
+        while((got = archive_read_data(a, text + len, size - len - 1)) > 0) {
+            len += got;
+            if(len + 2 > size) {
+                size *= 2;
+                text = realloc(text, size);
+            }
+        }
+        if(got < 0) {
+            goto cleanup;
+        }
+        /* keep a blank line between the files of a package */
+        text[len++] = '\n';
+        text[len++] = '\n';
+        pkgs[npkgs - 1].len += len - start;
+    }
+    if(r != ARCHIVE_EOF) {
+        goto cleanup;
+    }
+
+    /* the packages' texts follow each other in the buffer, which is only
+     * done moving now */
+    for(i = 0, len = 0; i < npkgs; i++) {
+        pkgs[i].text = text + len;
+        len += pkgs[i].len;
+    }
+    db = desc_build(dbname, 0, syncdb_fields, pkgs, npkgs);
+
+cleanup:
+    archive_read_free(a);
+    free(lastdir);
+    free(pkgs);
+    free(text);
+    return db;
+}
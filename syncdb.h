@@ -0,0 +1,12 @@
+#ifndef PACFIND_SYNCDB_H
+#define PACFIND_SYNCDB_H
+
+#include "snapshot.h"
+
+/* reads the sync database archive at path (a tar file, compressed with
+ * anything libarchive understands) straight into a dbsnap_t, without going
+ * through libalpm's package objects.  Packages are ordered by name, as
+ * libalpm orders them.  Returns NULL if the archive cannot be read */
+dbsnap_t *syncdb_read(const char *path, const char *dbname);
+
+#endif /* PACFIND_SYNCDB_H */
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ere.h"
+#include "trigram.h"
+
+#define TRIGRAM_KEY(col, a, b, c) \
+    (((uint32_t) (col) << 24) | ((uint32_t) (a) << 16) | ((uint32_t) (b) << 8) | (c))
+
+typedef struct posting_t {
+    uint32_t key;
+    uint32_t id;
+} posting_t;
+
+static inline unsigned char lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+}
+
+int trigram_indexed(strcol_t col) {
+    return col == SCOL_NAME || col == SCOL_DESC || col == SCOL_URL;
+}
+
+int posting_cmp(const void *a, const void *b) {
+    const posting_t *pa = a, *pb = b;
+    if(pa->key != pb->key) {
+        return pa->key < pb->key ? -1 : 1;
+    }
+    return pa->id < pb->id ? -1 : pa->id > pb->id;
+}
+
+void trigram_build(dbsnap_t *db) {
+    static const strcol_t cols[] = { SCOL_NAME, SCOL_DESC, SCOL_URL };
+    size_t size = 4096, count = 0, i, k;
+    posting_t *postings = malloc(size * sizeof(posting_t));
+    int c;
+
+    for(i = 0; i < db->count; i++) {
+        for(c = 0; c < 3; c++) {
+            const unsigned char *str;
+            uint32_t off = db->str_off[cols[c]][i], len = db->str_len[cols[c]][i], j;
+
+            if(off == SNAP_NULL || len < 3) {
+                continue;
+            }
+            str = (const unsigned char*) db->arena + off;
+            for(j = 0; j + 2 < len; j++) {
+                if(count == size) {
+                    size *= 2;
+                    postings = realloc(postings, size * sizeof(posting_t));
+                }
+                postings[count].key = TRIGRAM_KEY(cols[c],
+                        lower(str[j]), lower(str[j + 1]), lower(str[j + 2]));
+                postings[count++].id = i;
+            }
+        }
+    }
+    qsort(postings, count, sizeof(posting_t), posting_cmp);
+
+    db->tri_keys = malloc((count ? count : 1) * sizeof(uint32_t));
+    db->tri_start = malloc((count + 1) * sizeof(uint32_t));
+    db->tri_ids = malloc((count ? count : 1) * sizeof(uint32_t));
+    db->tri_nkeys = db->tri_nids = 0;
+
+    for(k = 0; k < count; k++) {
+        if(k && postings[k].key == postings[k - 1].key) {
+            /* a package mentioning a trigram twice is listed once */
+            if(postings[k].id == postings[k - 1].id) {
+                continue;
+            }
+        } else {
+            db->tri_keys[db->tri_nkeys] = postings[k].key;
+            db->tri_start[db->tri_nkeys++] = db->tri_nids;
+        }
+        db->tri_ids[db->tri_nids++] = postings[k].id;
+    }
+    db->tri_start[db->tri_nkeys] = db->tri_nids;
+
+    free(postings);
+}
+
+/* sets the packages of one database that contain a trigram */
+void trigram_lookup(const dbsnap_t *db, size_t base, uint32_t key, bitset_t *out) {
+    size_t lo = 0, hi = db->tri_nkeys, i;
+
+    if(db->tri_start == NULL) {
+        for(i = 0; i < db->count; i++) {
+            bitset_set(out, base + i);
+        }
+        return;
+    }
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(db->tri_keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if(lo == db->tri_nkeys || db->tri_keys[lo] != key) {
+        return;
+    }
+    for(i = db->tri_start[lo]; i < db->tri_start[lo + 1]; i++) {
+        bitset_set(out, base + db->tri_ids[i]);
+    }
+}
+
+typedef struct trictx_t {
+    const snapshot_t *snap;
+    const ere_t *ere;
+    strcol_t col;
+} trictx_t;
+
+bitset_t *trigram_postings(trictx_t *ctx, const unsigned char *tri) {
+    bitset_t *b = bitset_new(ctx->snap->count);
+    uint32_t key = TRIGRAM_KEY(ctx->col, tri[0], tri[1], tri[2]);
+    size_t d;
+
+    for(d = 0; d < ctx->snap->ndbs; d++) {
+        trigram_lookup(ctx->snap->dbs[d], ctx->snap->base[d], key, b);
+    }
+    return b;
+}
+
+/* NULL stands for "every package", so intersecting with it is free */
+bitset_t *trigram_and(bitset_t *a, bitset_t *b) {
+    if(a == NULL) {
+        return b;
+    }
+    if(b) {
+        bitset_and(a, b);
+        bitset_free(b);
+    }
+    return a;
+}
+
+/* the single byte a case-folded set stands for, or -1 */
+int trigram_char(const uint64_t *set) {
+    int c, first = -1, n = 0;
+
+    for(c = 0; c < 256; c++) {
+        if(ere_set_test(set, c)) {
+            if(n++ == 0) {
+                first = c;
+            } else if(n > 2 || lower(first) != lower(c)) {
+                return -1;
+            }
+        }
+    }
+    return n == 0 ? -1 : lower(first);
+}
+
+bitset_t *trigram_node(trictx_t *ctx, int n);
+
+/* the operands of a concatenation in order; anchors match no text, so the
+ * literals on either side of them are still adjacent */
+void trigram_flatten(const ere_t *ere, int n, int **items, size_t *count, size_t *size) {
+    const erenode_t *node = &ere->nodes[n];
+
+    if(node->type == ERE_CAT) {
+        trigram_flatten(ere, node->left, items, count, size);
+        trigram_flatten(ere, node->right, items, count, size);
+        return;
+    }
+    if(node->type == ERE_BOL || node->type == ERE_EOL || node->type == ERE_EMPTY) {
+        return;
+    }
+    if(*count == *size) {
+        *size *= 2;
+        *items = realloc(*items, *size * sizeof(int));
+    }
+    (*items)[(*count)++] = n;
+}
+
+bitset_t *trigram_run(trictx_t *ctx, const unsigned char *run, size_t len) {
+    bitset_t *req = NULL;
+    size_t i;
+
+    for(i = 0; i + 2 < len; i++) {
+        req = trigram_and(req, trigram_postings(ctx, run + i));
+    }
+    return req;
+}
+
+bitset_t *trigram_cat(trictx_t *ctx, int n) {
+    size_t size = 16, count = 0, i, len = 0;
+    int *items = malloc(size * sizeof(int));
+    unsigned char *run;
+    bitset_t *req = NULL;
+
+    trigram_flatten(ctx->ere, n, &items, &count, &size);
+    run = malloc(count + 1);
+
+    for(i = 0; i < count; i++) {
+        const erenode_t *node = &ctx->ere->nodes[items[i]];
+        int c = node->type == ERE_SET ? trigram_char(node->set) : -1;
+
+        if(c >= 0) {
+            run[len++] = c;
+            continue;
+        }
+        req = trigram_and(req, trigram_run(ctx, run, len));
+        req = trigram_and(req, trigram_node(ctx, items[i]));
+        len = 0;
+    }
+    req = trigram_and(req, trigram_run(ctx, run, len));
+
+    free(run);
+    free(items);
+    return req;
+}
+
+/* the packages a node can possibly match in, or NULL if it requires no
+ * trigram: each literal run of a concatenation requires all of its
+ * trigrams, an alternation requires those of either branch and x+
+ * requires those of x */
+bitset_t *trigram_node(trictx_t *ctx, int n) {
+    const erenode_t *node = &ctx->ere->nodes[n];
+    bitset_t *left, *right;
+
+    switch(node->type) {
+        case ERE_CAT:
+            return trigram_cat(ctx, n);
+        case ERE_ALT:
+            if((left = trigram_node(ctx, node->left)) == NULL) {
+                return NULL;
+            }
+            if((right = trigram_node(ctx, node->right)) == NULL) {
+                bitset_free(left);
+                return NULL;
+            }
+            bitset_or(left, right);
+            bitset_free(right);
+            return left;
+        case ERE_PLUS:
+            return trigram_node(ctx, node->left);
+        default:
+            return NULL;
+    }
+}
+
+bitset_t *trigram_candidates(const snapshot_t *snap, strcol_t col, const char *pattern) {
+    trictx_t ctx = { snap, NULL, col };
+    bitset_t *cand;
+    size_t d;
+
+    if(!trigram_indexed(col)) {
+        return NULL;
+    }
+    for(d = 0; d < snap->ndbs && snap->dbs[d]->tri_start == NULL; d++);
+    if(d == snap->ndbs || (ctx.ere = ere_parse(pattern, 1)) == NULL) {
+        return NULL;
+    }
+
+    cand = trigram_node(&ctx, ctx.ere->root);
+    ere_free((ere_t*) ctx.ere);
+    return cand;
+}
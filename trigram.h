@@ -0,0 +1,18 @@
+#ifndef PACFIND_TRIGRAM_H
+#define PACFIND_TRIGRAM_H
+
+#include "bitset.h"
+#include "snapshot.h"
+
+/* posting lists of the (ASCII lowercased) trigrams of the name, description
+ * and url of every package in a database: the packages containing trigram
+ * tri_keys[k] are tri_ids[tri_start[k]] through tri_ids[tri_start[k + 1] - 1] */
+int trigram_indexed(strcol_t col);
+void trigram_build(dbsnap_t *db);
+
+/* the packages whose column can possibly match an extended regex, or NULL
+ * if the regex requires no trigram; databases without an index contribute
+ * all of their packages */
+bitset_t *trigram_candidates(const snapshot_t *snap, strcol_t col, const char *pattern);
+
+#endif /* PACFIND_TRIGRAM_H */
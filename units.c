@@ -0,0 +1,145 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "units.h"
+
+/* a non-negative decimal number, leaving end at its suffix; strtod alone
+ * would also take signs, hex, "inf" and "nan" */
+int units_number(const char *str, double *value, const char **end) {
+    char *e;
+
+    if(!isdigit((unsigned char) *str) && *str != '.') {
+        return -1;
+    }
+    *value = strtod(str, &e);
+    if(e == str || !isfinite(*value)) {
+        return -1;
+    }
+    *end = e;
+    return 0;
+}
+
+/* bytes with an optional binary multiple: 100M, 1.5GiB, 512kb */
+int units_size(const char *str, int64_t range[2]) {
+    static const char prefixes[] = "kmgtpe";
+    const char *end, *p;
+    double value;
+
+    if(units_number(str, &value, &end) != 0) {
+        return -1;
+    }
+    if(*end && (p = strchr(prefixes, tolower((unsigned char) *end)))) {
+        value = ldexp(value, 10 * (p - prefixes + 1));
+        end++;
+        if(*end == 'i') {
+            end++;
+        }
+    }
+    if(tolower((unsigned char) *end) == 'b') {
+        end++;
+    }
+    if(*end || value >= 9223372036854775807.0) {
+        return -1;
+    }
+
+    range[0] = range[1] = llround(value);
+    return 0;
+}
+
+/* YYYY-MM-DD[( |T)HH:MM[:SS]] in local time; the range ends where the next
+ * day, minute or second begins */
+int units_datetime(const char *str, int64_t range[2]) {
+    struct tm tm, next;
+    int n = 0, *last;
+    time_t start, end;
+
+    memset(&tm, 0, sizeof(tm));
+    if(sscanf(str, "%4d-%2d-%2d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &n) != 3) {
+        return -1;
+    }
+    str += n;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    next = tm;
+    last = &next.tm_mday;
+
+    if(*str == ' ' || *str == 'T') {
+        n = 0;
+        if(sscanf(str + 1, "%2d:%2d%n", &tm.tm_hour, &tm.tm_min, &n) != 2) {
+            return -1;
+        }
+        str += n + 1;
+        next = tm;
+        last = &next.tm_min;
+        if(*str == ':') {
+            n = 0;
+            if(sscanf(str + 1, "%2d%n", &tm.tm_sec, &n) != 1) {
+                return -1;
+            }
+            str += n + 1;
+            next = tm;
+            last = &next.tm_sec;
+        }
+    }
+    if(*str) {
+        return -1;
+    }
+
+    (*last)++;
+    if((start = mktime(&tm)) == (time_t) -1 || (end = mktime(&next)) == (time_t) -1) {
+        return -1;
+    }
+    range[0] = start;
+    range[1] = end - 1;
+    return 0;
+}
+
+/* a date, a unix timestamp (optionally prefixed with @) or an age such as
+ * 2w, which means that long before now */
+int units_date(const char *str, int64_t now, int64_t range[2]) {
+    static const struct {
+        const char *suffix;
+        int64_t seconds;
+    } ages[] = {
+        {"s", 1},
+        {"min", 60},
+        {"h", 60 * 60},
+        {"d", 24 * 60 * 60},
+        {"w", 7 * 24 * 60 * 60},
+        {"mo", 30 * 24 * 60 * 60},
+        {"y", 365 * 24 * 60 * 60},
+    };
+    const char *end;
+    double value;
+    size_t i;
+
+    if(units_datetime(str, range) == 0) {
+        return 0;
+    }
+
+    if(*str == '@' || (units_number(str, &value, &end) == 0 && *end == '\0')) {
+        char *e;
+        long long ts = strtoll(str + (*str == '@'), &e, 10);
+        if(e == str + (*str == '@') || *e) {
+            return -1;
+        }
+        range[0] = range[1] = ts;
+        return 0;
+    }
+
+    if(units_number(str, &value, &end) != 0) {
+        return -1;
+    }
+    for(i = 0; i < sizeof(ages) / sizeof(ages[0]); i++) {
+        if(strcmp(end, ages[i].suffix) == 0) {
+            range[0] = range[1] = now - llround(value * ages[i].seconds);
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,11 @@
+#ifndef PACFIND_UNITS_H
+#define PACFIND_UNITS_H
+
+#include <stdint.h>
+
+/* query values for numeric fields, parsed into the inclusive range of
+ * values they denote: a date without a time covers the whole day */
+int units_size(const char *str, int64_t range[2]);
+int units_date(const char *str, int64_t now, int64_t range[2]);
+
+#endif /* PACFIND_UNITS_H */